@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# runs the benchmark corpus (benchworld.py) through the headless runner and
+# compares the results against a stored baseline. exits non-zero if a view
+# fails, if a baseline view is missing from the results, or if a metric
+# regresses past its threshold. views not in the baseline are listed as new.
+#
+#   ./bench.py            run and compare against bench_baseline.json
+#   ./bench.py --update   run and store the results as the new baseline
+
+import sys, os, json, subprocess
+
+RUNNER = "./iced_sdl2_opengl4"
+WORLD = "benchworld"
+RESULTS = "bench_results.json"
+BASELINE = "bench_baseline.json"
+
+# metric -> (relative threshold, absolute slack); a metric regresses when
+# new > old*relative + slack. the slack keeps tiny timings from flapping.
+THRESHOLDS = {
+	"codegen_s":    (1.25, 0.005),
+	"source_bytes": (1.02, 64),
+	"compile_s":    (1.25, 0.020),
+	"gpu_ms":       (1.20, 0.050),
+}
+
+def metrics(result):
+	# flattens a result into {metric_key: (threshold_key, value)}
+	ms = {}
+	for k in ("codegen_s", "source_bytes", "compile_s"):
+		if k in result: ms[k] = (k, result[k])
+	for res,v in result.get("gpu_ms", {}).items():
+		ms["gpu_ms@%s" % res] = ("gpu_ms", v)
+	return ms
+
+def load(path):
+	with open(path) as f: return {r["name"]: r for r in json.load(f)["results"]}
+
+def main():
+	update = "--update" in sys.argv[1:]
+	if os.path.exists(RESULTS): os.remove(RESULTS)
+	r = subprocess.run([RUNNER, "--world", WORLD, "--bench", RESULTS])
+	if not os.path.exists(RESULTS):
+		print("bench: runner produced no results (exit code %d)" % r.returncode)
+		return 1
+	results = load(RESULTS)
+	failed = r.returncode != 0
+
+	for name,result in results.items():
+		if result.get("error"):
+			print("FAIL %s: failed to generate/compile" % name)
+			failed = True
+
+	if update or not os.path.exists(BASELINE):
+		if failed:
+			print("bench: not writing baseline %s from a failed run" % BASELINE)
+			return 1
+		with open(RESULTS) as f0, open(BASELINE, "w") as f1: f1.write(f0.read())
+		print("bench: wrote baseline %s" % BASELINE)
+		return 0
+
+	baseline = load(BASELINE)
+	n_regressions = 0
+	for name in baseline:
+		if name not in results:
+			print("FAIL %s: in the baseline but not in the results" % name)
+			failed = True
+	for name,result in results.items():
+		if name not in baseline:
+			print("%-10s %s" % ("new", name))
+			continue
+		old = metrics(baseline[name])
+		for key,(tk,v1) in metrics(result).items():
+			if key not in old: continue
+			v0 = old[key][1]
+			rel,slack = THRESHOLDS[tk]
+			limit = v0*rel + slack
+			status = "ok"
+			if v1 > limit:
+				status = "REGRESSION"
+				n_regressions += 1
+			print("%-10s %-20s %-18s %12.4f -> %12.4f (limit %.4f)" % (status, name, key, v0, v1, limit))
+
+	if n_regressions > 0:
+		print("bench: %d regression(s) against %s" % (n_regressions, BASELINE))
+		failed = True
+	return 1 if failed else 0
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,87 @@
+# benchmark corpus for `make bench` (see bench.py). views are generated at
+# growing sizes; every scene is placed so it's visible from the default
+# camera of a freshly opened view window.
+import iclib
+from iclib import *
+
+iclib.print_source = False
+
+class mw(Material):
+	albedo = (1,1,1)
+
+class mr(Material):
+	albedo = (1,0,0)
+
+def _bench(dim, name, ctor):
+	ctor.__name__ = name
+	globals()[name] = (view2d if dim == 2 else view3d)(ctor)
+
+def _grid(n, dim):
+	# n points on a dim-dimensional grid, fitted into a box of side ~6
+	side = 1
+	while side**dim < n: side += 1
+	step = 6.0 / side
+	ps = []
+	for i in range(n):
+		c = []
+		for _ in range(dim):
+			c.append((i % side) * step)
+			i //= side
+		ps.append(c)
+	return ps, step
+
+def _spheres3(n):
+	def ctor():
+		ps, step = _grid(n, 3)
+		with mw:
+			for (x,y,z) in ps:
+				with translate3(-x, 3-y, 3-z): sphere3(step*0.4)
+	return ctor
+
+def _circles2(n):
+	def ctor():
+		ps, step = _grid(n, 2)
+		with mw:
+			for (x,y) in ps:
+				with translate2(3-x, 3-y): circle2(step*0.4)
+	return ctor
+
+def _smooth3(n):
+	def ctor():
+		ps, step = _grid(n, 3)
+		with chain(mw, smooth_union(step*0.3)):
+			for (x,y,z) in ps:
+				with translate3(-x, 3-y, 3-z): sphere3(step*0.4)
+	return ctor
+
+def _smooth2(n):
+	def ctor():
+		ps, step = _grid(n, 2)
+		with chain(mw, smooth_union(step*0.3)):
+			for (x,y) in ps:
+				with translate2(3-x, 3-y): circle2(step*0.4)
+	return ctor
+
+def _csgdeep3(depth):
+	ops = [subtract, union, intersect]
+	def rec(d):
+		if d == 0:
+			sphere3(2)
+			return
+		with ops[d % len(ops)]:
+			with translate3(0.05*(d%3), 0.05*(d%5), 0.05*(d%7)): sphere3(1.0 + 0.01*d)
+			rec(d-1)
+	def ctor():
+		with mr: rec(depth)
+	return ctor
+
+for n in (10, 100, 1000, 10000):
+	_bench(3, "spheres3_%d" % n, _spheres3(n))
+	_bench(2, "circles2_%d" % n, _circles2(n))
+
+for n in (10, 100, 1000):
+	_bench(3, "smooth3_%d" % n, _smooth3(n))
+	_bench(2, "smooth2_%d" % n, _smooth2(n))
+
+for depth in (8, 32, 128):
+	_bench(3, "csgdeep3_%d" % depth, _csgdeep3(depth))
@@ -3,9 +3,14 @@
 #include <assert.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <time.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
@@ -15,6 +20,8 @@
 #include "iced.h"
 #include "stb_ds.h"
 #include "gb_math.h"
+#include "pngw.h"
+#include "icir.h"
 
 static uint64_t _serial;
 static uint64_t next_serial(void)
@@ -217,6 +224,95 @@ struct view {
 	int dim;
 	GLuint prg0;
 	uint64_t serial;
+	// scene IR matching prg0, for CPU-side consumers (see icir.h)
+	void* ir_data;
+	size_t ir_size;
+	struct icir ir;
+	bool has_ir;
+	size_t source_hash; // of the source prg0 was compiled from
+	// the IR's params, for views that read them from a buffer instead of
+	// literals (iclib.bulk_params); persistently mapped, see view_upload_params()
+	bool uses_params;
+	GLuint params_buffer;
+	float* params_map;
+	size_t params_capacity; // bytes
+	GLsync params_fence; // after the last draw reading params_buffer
+	// prg0 is the IR-interpreting fallback (see compile_view()), reading
+	// ir_buffer (icir_glsl_buffer()) next to params_buffer
+	bool uses_fallback;
+	GLuint ir_buffer;
+	// the IR's material table, which map_dm() indexes (see iclib's
+	// MaterialSet.mkpalette())
+	bool uses_palette;
+	GLuint palette_buffer;
+};
+
+// what a view constructor returns (iclib's _ViewGen)
+struct view_gen {
+	const char* source;
+	const char* fallback;
+	const char* stats;
+	const void* ir_data;
+	size_t ir_size;
+};
+
+struct camera_key {
+	gbVec3 origin;
+	float fov;
+	float pitch;
+	float yaw;
+};
+
+#define MAX_LIGHTS (4) // u_light_pos/u_light_color in iclib's 3D template
+
+// 3D lighting and shading of a view window; uploaded as uniforms by
+// draw_view_region(). changing only these reshades the G-buffer of the
+// window's render result instead of marching again (see
+// acquire_render_result())
+struct light {
+	bool enabled;
+	bool follow_camera; // position is relative to the camera origin
+	gbVec3 position;
+	gbVec3 color; // includes intensity; falls off with 1/r^2
+};
+
+struct lighting {
+	struct light lights[MAX_LIGHTS];
+	float ambient;
+	int shadow_steps; // shadow march budget per light; 0 disables shadows
+	float penumbra; // higher is harder
+	int ao_taps; // 0 disables ambient occlusion
+	float ao_step; // distance between AO taps
+	int shading; // enum shading
+	float exposure;
+	bool tonemap;
+	int heat_max; // cost heatmaps turn white here
+};
+
+// primary march kernel of a 3D view window (march3d() in iclib's 3D
+// template). changing it takes a new geometry pass
+enum march_kernel {
+	MARCH_PLAIN = 0, // sphere tracing
+	MARCH_RELAXED, // over-relaxed sphere tracing, falling back on overshoot
+};
+
+struct march {
+	int kernel; // enum march_kernel
+	float relaxation; // step scale for MARCH_RELAXED; 1..2
+	bool adaptive_epsilon; // hit epsilon grows with the pixel footprint
+	float far;
+	int max_steps;
+};
+
+// u_shading in iclib's 3D template
+enum shading {
+	SHADING_LIT = 0,
+	SHADING_NORMALS,
+	SHADING_DEPTH,
+	// cost heatmaps; the shading pass also collects COST_METRICS for them
+	SHADING_STEPS,
+	SHADING_MAP_CALLS,
+	SHADING_SHADOW_STEPS,
 };
 
 struct view_window {
@@ -228,14 +324,15 @@ struct view_window {
 
 	int pixel_size;
 
-	bool gl_initialized;
-	int fb_width, fb_height;
-	GLuint framebuffer;
-	GLuint texture;
 	ImVec2 canvas_size;
 
-	uint64_t serial;
-	uint64_t seen_serial;
+	int render_result; // 3D; index into render_result_arr, or -1
+	ImVec2 uv0, uv1;
+	bool do_clone;
+	bool do_render_offline;
+	bool do_render_sequence;
+
+	struct camera_key* camera_key_arr; // 3D camera path, see camera_path_eval()
 
 	struct {
 		gbVec2 origin;
@@ -250,25 +347,245 @@ struct view_window {
 		float yaw;
 		bool is_flying;
 	} d3;
+
+	struct lighting lighting;
+	struct march march;
+};
+
+// per-pixel costs the shading pass collects with a cost heatmap shown (see
+// FRAGMENT_MAIN_3D): primary march steps, map calls and shadow steps
+enum {
+	COST_STEPS = 0,
+	COST_MAP_CALLS,
+	COST_SHADOW_STEPS,
+	COST_METRICS
+};
+#define COST_BINS (4096) // as in FRAGMENT_MAIN_3D; costs beyond go to the last bin
+#define COST_STRIDE (3+COST_BINS) // uints per metric in the CostStats buffer
+
+struct cost_stats {
+	double mean;
+	int p99;
+	int max;
+};
+
+// renders of 3D view windows; shared between windows showing the same view
+// with the same camera and resolution (2D windows use the tile cache). slots
+// are never removed from render_result_arr so view windows can refer to them
+// by index; unreferenced slots are recycled or released in iced_render().
+struct render_result {
+	bool in_use;
+	bool dirty;
+	bool reshade; // 3D; only the lighting changed, the G-buffer is current
+	int last_used_frame;
+	int owner; // index into view_window_arr; camera source when dirty
+
+	uint64_t view_serial;
+	int width, height;
+	int pixel_size;
+	struct {
+		gbVec3 origin;
+		float fov;
+		float pitch;
+		float yaw;
+	} cam;
+	struct lighting lighting;
+	struct march march;
+
+	int target; // index into render_target_arr, or -1
+
+	// CostStats buffer of the last shading pass that collected costs, read
+	// back once cost_fence has signalled
+	GLuint cost_buffer;
+	GLsync cost_fence;
+	bool has_cost;
+	struct cost_stats cost[COST_METRICS];
+};
+
+#define RENDER_RESULT_SPARE (4) // unreferenced results kept around for reuse
+
+// render targets are pooled textures+framebuffers whose dimensions are
+// rounded up to size buckets (see render_target_bucket()); a render result
+// draws into the lower-left width x height corner and samples it with scaled
+// UVs, so resizing a window within a bucket allocates nothing. free targets
+// are kept until the pool exceeds RENDER_TARGET_BUDGET, then released least
+// recently used first.
+struct render_target {
+	bool in_use;
+	int last_used_frame;
+	int width, height;
+	GLuint framebuffer;
+	GLuint texture;
+	// G-buffer for 3D views, allocated on first use (render_target_gbuffer())
+	GLuint gbuffer_framebuffer;
+	GLuint gbuffer_textures[2]; // RGBA32F normal+distance, RGBA32I material+steps+map calls
+};
+
+#define RENDER_TARGET_BUDGET (256<<20) // bytes
+
+// 2D view windows draw from a cache of world-space tiles instead of render
+// results (see draw_view_tiles()). tiles form a quadtree over power-of-two
+// levels: a level L tile has TILE_SIZE^2 texels that are 2^L world units wide,
+// and its four children are the level L-1 tiles covering it. panning renders
+// only the tiles that come into view; while zooming, tiles of the nearest
+// cached level are drawn scaled until the new level has streamed in at up to
+// TILE_BUDGET tiles per frame, nearest the window center first.
+//
+// all tiles live in slots of one atlas texture; each slot holds a tile and a
+// texel of gutter around it (rendered like the rest) so that bilinear
+// filtering never reaches into the neighbouring slot
+#define TILE_SIZE (126)
+#define TILE_SLOT (TILE_SIZE+2)
+#define TILE_ATLAS_SIZE (4096)
+#define TILE_ATLAS_SLOTS (TILE_ATLAS_SIZE/TILE_SLOT) // per axis
+#define TILE_BUDGET (128) // tiles rendered per frame; as in TileDraws (2D vertex shader)
+#define TILE_FALLBACK_LEVELS (6) // coarser levels searched for a missing tile
+
+// used as a stb_ds hash map key, so memset() before filling it in
+struct tile_key {
+	uint64_t view_serial;
+	int level;
+	int x, y; // the tile covers [x;x+1]*TILE_SIZE*2^level in world space, likewise y
+};
+
+struct tile {
+	bool in_use;
+	bool ready;
+	bool scheduled; // rendered in this frame's tile_cache_render()
+	struct tile_key key;
+	int view; // index into view_arr, when scheduled
+	int last_used_frame;
+};
+
+// thumbnail gallery of the views in viewlist() (window_gallery()).
+// thumbnails are made lazily, for the entries in sight, in at most
+// GALLERY_BUDGET per frame (see gallery_update()): codegen on the gallery's
+// own worker, which a frame never waits for, then compile (unless the view is
+// open anyway) and a render with the default camera. they're cached in
+// GALLERY_CACHE_DIR, one file per thumbnail named by the hash of the view's
+// source and IR, and an index per world maps view names to the hash of their
+// last thumbnail, so on restart the gallery shows those at once and only
+// renders again what has changed since
+#define THUMB_WIDTH (160)
+#define THUMB_HEIGHT (120)
+#define GALLERY_BUDGET (0.008) // seconds
+#define GALLERY_CACHE_DIR ".iced-thumbs"
+
+enum thumb_state {
+	THUMB_PENDING = 0, // not checked against the view since the world was loaded
+	THUMB_REQUESTED, // codegen in flight on the gallery worker
+	THUMB_READY, // codegen done, reply waits for its compile and render
+	THUMB_CURRENT,
+	THUMB_FAILED, // the view's constructor or compile failed
+};
+
+struct thumb {
+	char* name;
+	int dim;
+	int state; // enum thumb_state
+	size_t hash; // of the thumbnail in texture (or on disk, with texture 0)
+	GLuint texture; // or 0
+	bool visible; // in sight in the last frame's gallery
+	struct codegen_job* reply; // THUMB_READY
+};
+
+// view constructors run in a pool of icworker.py processes, see codegen_run().
+// a worker that takes longer than CODEGEN_TIMEOUT on a request is killed and
+// respawned
+struct codegen_worker {
+	pid_t pid;
+	int request_fd; // worker stdin
+	int reply_fd; // worker stdout
+	int job; // index of the in-flight job, or -1 when idle
+	struct timespec t0;
+	char* reply_arr;
+};
+
+struct codegen_job {
+	char request[1<<8];
+	int worker; // worker index the job must run on, or -1 for any
+	struct view* view; // for "view" requests
+	bool ok;
+	char* payload; // reply payload (malloc'd, NUL terminated)
+	size_t payload_size;
+	double duration; // request to reply
+};
+
+#define CODEGEN_TIMEOUT (10.0) // seconds
+#define PYTHON_IDLE_FRAMES (30) // without input before python_housekeeping() runs
+
+// a subinterpreter: the thread state Py_NewInterpreter() returned, on
+// whichever thread made it, and the UI thread's own state in it
+struct python_interp {
+	PyThreadState* created;
+	PyThreadState* ui;
 };
 
 static struct globals {
 	bool python_initialized;
 	bool python_do_reinitialize;
+	PyThreadState* python_tstate; // UI thread's state in the subinterpreter running the world
+	PyThreadState* python_created_tstate; // that subinterpreter's, see reload_script()
+	PyThreadState* python_spare_tstate; // pre-warmed for the next hard reload
+	struct python_interp* python_retired_arr; // left for python_housekeeping()
+	bool python_holding_gil;
+	bool python_housekeeping_busy;
+	int python_idle_frames; // frames since the last input
 	PyObject* python_world_module;
 	PyObject* python_iclib_module;
+	int codegen_n_workers; // 0: run view constructors in-process
 	bool has_error;
 	char error_message[1<<14];
 	char* watch_paths_arr;
 	struct timespec last_load_time;
+	bool watch_disabled; // reloads only come from iced_request_reload()
+	bool reload_requested;
+	bool watch_reloaded; // since the last iced_watch_reloaded()
 	double duration_load;
 	double duration_exec;
+	double duration_compile;
+	int n_updates_skipped; // reloads that left a view's program alone, see update_view()
+	int n_updates_uploaded;
+	int n_updates_compiled;
+	int glsl_budget_soft; // in lines of view source; see check_glsl_budget()
+	int glsl_budget_hard;
+	size_t source_size;
+	const char* world_module_name;
 	GLuint vao0;
+	GLuint tile_atlas;
+	GLuint tile_framebuffer;
+	GLuint tile_draw_buffer; // TileDraws in the 2D vertex shader
+	uint64_t world_serial; // new on every (re)load of the world
+	struct {
+		bool show;
+		uint64_t world_serial; // thumb_arr is from viewlist() of this load
+		bool index_dirty;
+		GLuint framebuffer;
+		struct codegen_worker worker; // see gallery_worker_poll()
+		char request_name[1<<8]; // of the view the worker is on
+		double reply_duration; // of the last compile and render of a reply
+	} gallery;
+	int tiles_frame; // frame n_tiles_scheduled counts for
+	int n_tiles_scheduled;
 	struct view_window* flying_view_window;
 	gbVec3 save_origin;
 	float save_pitch;
 	float save_yaw;
 	int flystate;
+	bool show_frame_pacing;
+	int frame;
+	struct {
+		int size[2];
+		int tile_size;
+		int aa;
+		char path[1<<10];
+	} offline;
+	struct {
+		int size[2];
+		int n_frames;
+		char path[1<<10]; // printf pattern taking the frame number
+		double fps;
+	} sequence;
 } g;
 
 static void watch_file(const char* path)
@@ -317,6 +634,12 @@ static double timer_end(struct timespec t0)
 
 static struct view* view_arr;
 static struct view_window* view_window_arr;
+static struct render_result* render_result_arr;
+static struct render_target* render_target_arr;
+static struct tile* tile_arr; // one per atlas slot, row major
+static struct { struct tile_key key; int value; }* tile_map; // tile_arr index by key
+static struct codegen_worker* codegen_worker_arr;
+static struct thumb* thumb_arr;
 
 
 #define IS_Q0 "(gl_VertexID == 0 || gl_VertexID == 3)"
@@ -324,6 +647,124 @@ static struct view_window* view_window_arr;
 #define IS_Q2 "(gl_VertexID == 2 || gl_VertexID == 4)"
 #define IS_Q3 "(gl_VertexID == 5)"
 
+// fragment shader tail shared by 2D and 3D views. u_aa selects the mode:
+//   0: plain render (default)
+//   1: first pass of an offline render; depth goes into alpha
+//   n>1: refinement pass of an offline render; pixels whose first pass
+//        neighbours disagree on depth or colour get n x n samples, the rest
+//        copy the first pass (see render_offline())
+// RENDER is the render call with the sample position as the last-but-one
+// argument left open, e.g. "render3d(u_origin, " for render3d(u_origin, dir,
+// depth). ddx, ddy (the varying's derivatives) and n (samples per axis) are in
+// scope for it
+#define FRAGMENT_MAIN(TYPE, VARYING, RENDER) \
+	"\n" \
+	"layout (location = 8) uniform int u_aa;\n" \
+	"layout (location = 9) uniform ivec2 u_aa_offset;\n" \
+	"layout (binding = 0) uniform sampler2D u_first_pass;\n" \
+	"\n" \
+	"layout (location = 0) out vec4 frag_color;\n" \
+	"\n" \
+	"bool aa_edge(vec4 a, ivec2 p)\n" \
+	"{\n" \
+	"	vec4 b = texelFetch(u_first_pass, p, 0);\n" \
+	"	if ((a.w < 0.0) != (b.w < 0.0)) return true;\n" \
+	"	if (abs(a.w - b.w) > 0.02*max(abs(a.w), abs(b.w))) return true;\n" \
+	"	vec3 dc = abs(a.rgb - b.rgb);\n" \
+	"	return max(dc.r, max(dc.g, dc.b)) > 0.1;\n" \
+	"}\n" \
+	"\n" \
+	"void main()\n" \
+	"{\n" \
+	"	" TYPE " ddx = dFdx(" VARYING ");\n" \
+	"	" TYPE " ddy = dFdy(" VARYING ");\n" \
+	"	int n = 1;\n" \
+	"	vec4 c0 = vec4(0.0);\n" \
+	"	if (u_aa > 1) {\n" \
+	"		ivec2 ip = ivec2(gl_FragCoord.xy) + u_aa_offset;\n" \
+	"		c0 = texelFetch(u_first_pass, ip, 0);\n" \
+	"		bool edge =\n" \
+	"			aa_edge(c0, ip+ivec2(1,0)) || aa_edge(c0, ip-ivec2(1,0)) ||\n" \
+	"			aa_edge(c0, ip+ivec2(0,1)) || aa_edge(c0, ip-ivec2(0,1));\n" \
+	"		n = edge ? u_aa : 0;\n" \
+	"	}\n" \
+	"	vec3 acc = vec3(0.0);\n" \
+	"	float depth = 1.0;\n" \
+	"	for (int i = 0; i < n*n; i++) {\n" \
+	"		vec2 o = n > 1 ? (vec2(i%n, i/n)+0.5)/float(n) - 0.5 : vec2(0.0);\n" \
+	"		acc += " RENDER VARYING " + o.x*ddx + o.y*ddy, depth);\n" \
+	"	}\n" \
+	"	frag_color = n > 0 ? vec4(acc/float(n*n), u_aa == 1 ? depth : 1.0) : vec4(c0.rgb, 1.0);\n" \
+	"}\n"
+
+// 3D views render interactively in two passes (see iced_render()) selected
+// by u_pass:
+//   0: forward; geometry and shading in one, for offline renders
+//   1: geometry pass into the G-buffer (struct render_target), with u_aa 1
+//      so that FRAGMENT_MAIN puts the hit distance (negative on a miss) next
+//      to the normal in attachment 0; material ID, march steps and map calls
+//      go to attachment 1
+//   2: shading pass reading the G-buffer; lighting or a debug view, without
+//      marching the primary ray again. with a cost heatmap it also adds each
+//      pixel's costs to the CostStats buffer (see render_result_read_cost())
+// render3d() has a single call site for geometry3d() and shade_pixel(); a
+// copy per pass would multiply the inlined scene code
+#define FRAGMENT_MAIN_3D \
+	"\n" \
+	"layout (location = 4) uniform int u_pass;\n" \
+	"layout (binding = 1) uniform sampler2D u_gbuffer_hit;\n" \
+	"layout (binding = 2) uniform isampler2D u_gbuffer_id;\n" \
+	"\n" \
+	"layout (location = 1) out ivec3 g_id;\n" \
+	"\n" \
+	"// per metric: 64-bit sum (low word first), max, then a histogram\n" \
+	"layout (std430, binding = 3) buffer CostStats {\n" \
+	"	uint u_cost[];\n" \
+	"};\n" \
+	"const int COST_BINS = 4096;\n" \
+	"\n" \
+	"void cost_add(int metric, int n)\n" \
+	"{\n" \
+	"	int base = metric*(3+COST_BINS);\n" \
+	"	uint v = uint(n);\n" \
+	"	uint lo = atomicAdd(u_cost[base], v);\n" \
+	"	if (lo + v < lo) atomicAdd(u_cost[base+1], 1u);\n" \
+	"	atomicMax(u_cost[base+2], v);\n" \
+	"	atomicAdd(u_cost[base+3+min(n, COST_BINS-1)], 1u);\n" \
+	"}\n" \
+	"\n" \
+	"vec3 render3d(vec3 o, vec3 d, out float depth)\n" \
+	"{\n" \
+	"	vec3 nd = normalize(d);\n" \
+	"	vec3 normal;\n" \
+	"	int id, steps, map_calls;\n" \
+	"	if (u_pass == 2) {\n" \
+	"		ivec2 ip = ivec2(gl_FragCoord.xy);\n" \
+	"		vec4 h = texelFetch(u_gbuffer_hit, ip, 0);\n" \
+	"		ivec3 m = texelFetch(u_gbuffer_id, ip, 0).xyz;\n" \
+	"		depth = h.w;\n" \
+	"		normal = h.xyz;\n" \
+	"		id = m.x;\n" \
+	"		steps = m.y;\n" \
+	"		map_calls = m.z;\n" \
+	"	} else {\n" \
+	"		depth = geometry3d(o, nd, normal, id, steps);\n" \
+	"		map_calls = n_map_calls;\n" \
+	"	}\n" \
+	"	if (u_pass == 1) {\n" \
+	"		g_id = ivec3(id, steps, map_calls);\n" \
+	"		return normal;\n" \
+	"	}\n" \
+	"	vec3 c = shade_pixel(o, nd, depth, normal, id, steps, map_calls);\n" \
+	"	if (u_pass == 2 && u_shading >= 3) {\n" \
+	"		cost_add(0, steps);\n" \
+	"		cost_add(1, n_map_calls);\n" \
+	"		cost_add(2, n_shadow_steps);\n" \
+	"	}\n" \
+	"	return c;\n" \
+	"}\n" \
+	FRAGMENT_MAIN("vec3", "v_dir", "render3d(u_origin, ")
+
 static void raise_errorf(const char* fmt, ...)
 {
 	va_list args;
@@ -376,20 +817,150 @@ static void handle_python_error(void)
 	g.python_initialized = false;
 }
 
-static void reload_view(struct view* view)
+static void view_set_ir(struct view* view, const void* ir_data, size_t ir_size)
 {
-	struct timespec t0 = timer_begin();
-	PyObject* pview = PyObject_GetAttrString(g.python_world_module, view->name);
-	PyObject* r = PyObject_CallObject(pview, NULL);
-	Py_DECREF(pview);
-	if (r == NULL) {
-		handle_python_error();
+	if (view->has_ir) icir_close(&view->ir);
+	view->has_ir = false;
+	free(view->ir_data);
+	view->ir_data = NULL;
+	view->ir_size = 0;
+	if (ir_size == 0) return;
+	view->ir_data = malloc(ir_size);
+	view->ir_size = ir_size;
+	memcpy(view->ir_data, ir_data, ir_size);
+	if (icir_open(&view->ir, view->ir_data, view->ir_size) != 0) {
+		fprintf(stderr, "WARNING: view `%s` returned invalid IR (%zu bytes)\n", view->name, ir_size);
 		return;
 	}
-	PyObject* psource = PyObject_GetAttrString(r, "source");
-	Py_DECREF(r);
-	const char* source = PyUnicode_AsUTF8(psource);
-	g.duration_exec = timer_end(t0);
+	view->has_ir = true;
+}
+
+static void view_upload_params(struct view* view)
+{
+	if (!view->uses_params || !view->has_ir) return;
+	const size_t size = (size_t)view->ir.n_params * sizeof(float);
+	if (size > view->params_capacity) {
+		if (view->params_buffer) {
+			glDeleteBuffers(1, &view->params_buffer); CHKGL;
+		}
+		size_t capacity = 1<<12;
+		while (capacity < size) capacity <<= 1;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &view->params_buffer); CHKGL;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, view->params_buffer); CHKGL;
+		glBufferStorage(GL_SHADER_STORAGE_BUFFER, capacity, NULL, flags); CHKGL;
+		view->params_map = (float*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, capacity, flags); CHKGL;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); CHKGL;
+		assert(view->params_map != NULL);
+		view->params_capacity = capacity;
+	} else if (view->params_fence != NULL) {
+		// don't pull the params out from under a draw still in flight.
+		// GL_WAIT_FAILED raises a GL error, so no CHKGL until it's taken
+		GLenum status;
+		do {
+			status = glClientWaitSync(view->params_fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1e9);
+		} while (status == GL_TIMEOUT_EXPIRED);
+		if (status == GL_WAIT_FAILED) {
+			const GLenum err = glGetError();
+			fprintf(stderr, "WARNING: view `%s`: waiting for the params fence failed (%s); using glFinish()\n", view->name, gl_err_string(err));
+			glFinish(); CHKGL;
+		}
+	}
+	if (view->params_fence != NULL) {
+		glDeleteSync(view->params_fence); CHKGL;
+		view->params_fence = NULL;
+	}
+	memcpy(view->params_map, view->ir.params, size);
+}
+
+static void view_upload_ir(struct view* view)
+{
+	if (!view->uses_fallback || !view->has_ir) return;
+	const size_t size = icir_glsl_buffer_size(&view->ir);
+	void* data = malloc(size);
+	icir_glsl_buffer(&view->ir, data);
+	if (!view->ir_buffer) {
+		glGenBuffers(1, &view->ir_buffer); CHKGL;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, view->ir_buffer); CHKGL;
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STATIC_DRAW); CHKGL;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); CHKGL;
+	free(data);
+}
+
+static void view_upload_palette(struct view* view)
+{
+	if (!view->uses_palette || !view->has_ir) return;
+	// vec4 per field; the table has vec3s
+	const int n = view->ir.n_materials;
+	float* data = (float*)calloc(gb_max(n, 1)*8, sizeof(float));
+	for (int i = 0; i < n; i++) {
+		memcpy(&data[i*8], &view->ir.materials[i*6], 3*sizeof(float));
+		memcpy(&data[i*8+4], &view->ir.materials[i*6+3], 3*sizeof(float));
+	}
+	if (!view->palette_buffer) {
+		glGenBuffers(1, &view->palette_buffer); CHKGL;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, view->palette_buffer); CHKGL;
+	glBufferData(GL_SHADER_STORAGE_BUFFER, gb_max(n, 1)*8*sizeof(float), data, GL_STATIC_DRAW); CHKGL;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); CHKGL;
+	free(data);
+}
+
+// checks a view's source size (from its stats, see iclib's _View.stats())
+// against the GLSL budgets. over the soft budget it warns, naming the node
+// types that emitted the most lines; over the hard budget it returns true if
+// the view can use the IR-interpreting fallback instead, whose compile time
+// doesn't grow with the scene
+static bool check_glsl_budget(struct view* view, const struct view_gen* gen)
+{
+	int n_lines = 0, n_nodes = 0, n_constants = 0, n;
+	const char* p = gen->stats;
+	if (p == NULL || sscanf(p, "lines %d\nnodes %d\nconstants %d\n%n", &n_lines, &n_nodes, &n_constants, &n) != 3) return false;
+	if (g.glsl_budget_soft <= 0 || n_lines <= g.glsl_budget_soft) return false;
+
+	const bool over_hard = g.glsl_budget_hard > 0 && n_lines > g.glsl_budget_hard;
+	fprintf(stderr, "WARNING: view `%s` is %d lines of GLSL (%s budget is %d); %d nodes, %d constants\n",
+		view->name, n_lines, over_hard ? "hard" : "soft", over_hard ? g.glsl_budget_hard : g.glsl_budget_soft, n_nodes, n_constants);
+	p += n;
+	for (int i = 0; i < 8; i++) {
+		char type[64];
+		int type_nodes, type_lines;
+		if (sscanf(p, "%63s %d %d\n%n", type, &type_nodes, &type_lines, &n) != 3 || type_lines == 0) break;
+		fprintf(stderr, "  %-20s %8d nodes %8d lines\n", type, type_nodes, type_lines);
+		p += n;
+	}
+	if (!over_hard) return false;
+
+	const char* reason = NULL;
+	struct icir ir;
+	if (gen->fallback == NULL || gen->fallback[0] == 0) {
+		reason = "no fallback";
+	} else if (icir_open(&ir, gen->ir_data, gen->ir_size) != 0) {
+		reason = "invalid IR";
+	} else {
+		if (ir.n_unknown_types > 0) {
+			reason = "node types the IR interpreter doesn't know";
+		} else if (icir_depth(&ir) > ICIR_GLSL_MAX_DEPTH) {
+			reason = "too deep for the IR interpreter";
+		}
+		icir_close(&ir);
+	}
+	if (reason != NULL) {
+		fprintf(stderr, "  compiling it anyway (%s)\n", reason);
+		return false;
+	}
+	fprintf(stderr, "  using the IR-interpreting fallback\n");
+	return true;
+}
+
+static void compile_view(struct view* view, const struct view_gen* gen)
+{
+	const uint64_t serial0 = view->serial;
+	g.source_size = strlen(gen->source);
+	const bool use_fallback = check_glsl_budget(view, gen);
+	const char* scene0 = use_fallback ? gen->fallback : gen->source;
+	const char* scene1 = use_fallback ? icir_glsl(view->dim) : "";
 
 	if (view->dim == 2) {
 		const char* sources[] = {
@@ -400,23 +971,44 @@ static void reload_view(struct view* view)
 			"layout (location = 0) uniform vec2 u_p0;\n"
 			"layout (location = 1) uniform vec2 u_p1;\n"
 			"\n"
+			"// batched draws (see tile_cache_render()) take their rectangles from\n"
+			"// TileDraws at u_draw_base+gl_DrawID instead: world space, then clip\n"
+			"// space. a uniform block, since GL requires no storage blocks in the\n"
+			"// vertex stage\n"
+			"layout (location = 2) uniform bool u_batched;\n"
+			"layout (location = 3) uniform int u_draw_base;\n"
+			"layout (std140, binding = 0) uniform TileDraws {\n"
+			"	vec4 u_tile_draws[256]; // 2*TILE_BUDGET\n"
+			"};\n"
+			"\n"
 			"out vec2 v_pos;\n"
 			"\n"
 			"void main()\n"
 			"{\n"
+			"	vec2 p0 = u_p0;\n"
+			"	vec2 p1 = u_p1;\n"
+			"	vec2 c0 = vec2(-1.0, -1.0);\n"
+			"	vec2 c1 = vec2( 1.0,  1.0);\n"
+			"	if (u_batched) {\n"
+			"		int i = 2*(u_draw_base + gl_DrawID);\n"
+			"		p0 = u_tile_draws[i].xy;\n"
+			"		p1 = u_tile_draws[i].zw;\n"
+			"		c0 = u_tile_draws[i+1].xy;\n"
+			"		c1 = u_tile_draws[i+1].zw;\n"
+			"	}\n"
 			"	vec2 c;\n"
 			"	if (" IS_Q0 ") {\n"
-			"		c = vec2(-1.0, -1.0);\n"
-			"		v_pos = vec2(u_p0.x, u_p0.y);\n"
+			"		c = vec2(c0.x, c0.y);\n"
+			"		v_pos = vec2(p0.x, p0.y);\n"
 			"	} else if (" IS_Q1 ") {\n"
-			"		c = vec2( 1.0, -1.0);\n"
-			"		v_pos = vec2(u_p1.x, u_p0.y);\n"
+			"		c = vec2(c1.x, c0.y);\n"
+			"		v_pos = vec2(p1.x, p0.y);\n"
 			"	} else if (" IS_Q2 ") {\n"
-			"		c = vec2( 1.0,  1.0);\n"
-			"		v_pos = vec2(u_p1.x, u_p1.y);\n"
+			"		c = vec2(c1.x, c1.y);\n"
+			"		v_pos = vec2(p1.x, p1.y);\n"
 			"	} else if (" IS_Q3 ") {\n"
-			"		c = vec2(-1.0,  1.0);\n"
-			"		v_pos = vec2(u_p0.x, u_p1.y);\n"
+			"		c = vec2(c0.x, c1.y);\n"
+			"		v_pos = vec2(p0.x, p1.y);\n"
 			"	}\n"
 			"	gl_Position = vec4(c,0.0,1.0);\n"
 			"}\n"
@@ -427,21 +1019,18 @@ static void reload_view(struct view* view)
 			"#version 460\n"
 			"\n"
 			,
-			source
+			scene0
+			,
+			scene1
 			,
 			"\n"
 			"in vec2 v_pos;\n"
-			"\n"
-			"layout (location = 0) out vec4 frag_color;\n"
-			"\n"
-			"void main()\n"
-			"{\n"
-			"	vec3 c = render2d(v_pos);\n"
-			"	frag_color = vec4(c, 1.0);\n"
-			"}\n"
+			FRAGMENT_MAIN("vec2", "v_pos", "render2d(max(length(ddx), length(ddy))/float(n), ")
 		};
 
-		GLuint new_prg = mk_render_program(1, 3, sources);
+		struct timespec t1 = timer_begin();
+		GLuint new_prg = mk_render_program(1, 4, sources);
+		g.duration_compile += timer_end(t1);
 		if (has_glsl_error) {
 			snprintf(g.error_message, sizeof g.error_message, "[GLSL ERROR] %s", glsl_error);
 			g.has_error = true;
@@ -451,6 +1040,9 @@ static void reload_view(struct view* view)
 			}
 			view->prg0 = new_prg;
 			view->serial = next_serial();
+			view->uses_params = glGetProgramResourceIndex(new_prg, GL_SHADER_STORAGE_BLOCK, "Params") != GL_INVALID_INDEX; CHKGL;
+			view->uses_fallback = use_fallback;
+			view->uses_palette = glGetProgramResourceIndex(new_prg, GL_SHADER_STORAGE_BLOCK, "Palette") != GL_INVALID_INDEX; CHKGL;
 		}
 
 	} else if (view->dim == 3) {
@@ -488,23 +1080,20 @@ static void reload_view(struct view* view)
 			"#version 460\n"
 			"\n"
 			,
-			source
+			scene0
+			,
+			scene1
 			,
 			"\n"
 			"layout (location = 0) uniform vec3 u_origin;\n"
 			"\n"
 			"in vec3 v_dir;\n"
-			"\n"
-			"layout (location = 0) out vec4 frag_color;\n"
-			"\n"
-			"void main()\n"
-			"{\n"
-			"	vec3 c = render3d(u_origin, v_dir);\n"
-			"	frag_color = vec4(c, 1.0);\n"
-			"}\n"
+			FRAGMENT_MAIN_3D
 		};
 
-		GLuint new_prg = mk_render_program(1, 3, sources);
+		struct timespec t1 = timer_begin();
+		GLuint new_prg = mk_render_program(1, 4, sources);
+		g.duration_compile += timer_end(t1);
 		if (has_glsl_error) {
 			snprintf(g.error_message, sizeof g.error_message, "[GLSL ERROR] %s", glsl_error);
 			g.has_error = true;
@@ -514,12 +1103,454 @@ static void reload_view(struct view* view)
 			}
 			view->prg0 = new_prg;
 			view->serial = next_serial();
+			view->uses_params = glGetProgramResourceIndex(new_prg, GL_SHADER_STORAGE_BLOCK, "Params") != GL_INVALID_INDEX; CHKGL;
+			view->uses_fallback = use_fallback;
+			view->uses_palette = glGetProgramResourceIndex(new_prg, GL_SHADER_STORAGE_BLOCK, "Palette") != GL_INVALID_INDEX; CHKGL;
 		}
 	} else {
 		assert(!"weird dim");
 	}
 
+	if (view->serial != serial0) {
+		view_set_ir(view, gen->ir_data, gen->ir_size);
+		view_upload_params(view);
+		view_upload_ir(view);
+		view_upload_palette(view);
+	}
+}
+
+static const char* change_name(int changed)
+{
+	if (changed & ICIR_CHANGED_STRUCTURE) return "structural";
+	switch (changed) {
+	case 0: return "none";
+	case ICIR_CHANGED_PARAMS: return "params";
+	case ICIR_CHANGED_MATERIALS: return "materials";
+	default: return "params+materials";
+	}
+}
+
+// brings a view up to date with what its constructor returned, taking the
+// cheapest path the change allows: when the source is the same as what prg0
+// was compiled from and the IR's structure hasn't changed, the program is
+// kept, and new params or materials (which the source then doesn't contain,
+// see iclib.bulk_params and the palette) are only uploaded. when nothing
+// changed at all the render results are kept too. reloads of an open view
+// are logged with the classification (see icir_diff()) and the time taken
+static void update_view(struct view* view, const struct view_gen* gen, double duration_codegen)
+{
+	struct timespec t0 = timer_begin();
+	const size_t source_hash = stbds_hash_bytes((void*)gen->source, strlen(gen->source), 0);
+	const bool is_reload = view->prg0 != 0;
+	int changed = ICIR_CHANGED_STRUCTURE;
+	struct icir ir;
+	if (view->has_ir && icir_open(&ir, gen->ir_data, gen->ir_size) == 0) {
+		changed = icir_diff(&view->ir, &ir);
+		icir_close(&ir);
+	}
+	// e.g. an iclib template change; nothing the IR can tell
+	if (changed == 0 && source_hash != view->source_hash) changed = ICIR_CHANGED_STRUCTURE;
+
+	const char* action;
+	int* counter;
+	if (is_reload && changed == 0) {
+		action = "kept";
+		counter = &g.n_updates_skipped;
+	} else if (is_reload && source_hash == view->source_hash && !(changed & ICIR_CHANGED_STRUCTURE)) {
+		view_set_ir(view, gen->ir_data, gen->ir_size);
+		view_upload_params(view);
+		view_upload_ir(view); // bounds follow the params
+		view_upload_palette(view);
+		view->serial = next_serial();
+		action = "uploaded";
+		counter = &g.n_updates_uploaded;
+	} else {
+		const uint64_t serial0 = view->serial;
+		compile_view(view, gen);
+		if (view->serial != serial0) view->source_hash = source_hash;
+		action = view->serial != serial0 ? "recompiled" : "compile failed";
+		counter = &g.n_updates_compiled;
+	}
+	if (is_reload) {
+		(*counter)++;
+		printf("reload: %s: %s change, %s in %.1fms (codegen %.1fms)\n",
+			view->name, change_name(changed), action, timer_end(t0)*1e3, duration_codegen*1e3);
+	}
+}
+
+static void codegen_worker_kill(struct codegen_worker* w)
+{
+	if (w->pid <= 0) return;
+	kill(w->pid, SIGKILL);
+	waitpid(w->pid, NULL, 0);
+	close(w->request_fd);
+	close(w->reply_fd);
+	w->pid = 0;
+	w->job = -1;
+	arrsetlen(w->reply_arr, 0);
+}
+
+static void codegen_worker_spawn(struct codegen_worker* w)
+{
+	assert(w->pid <= 0);
+	int req[2], rep[2];
+	assert(pipe2(req, O_CLOEXEC) == 0);
+	assert(pipe2(rep, O_CLOEXEC) == 0);
+	const char* python = getenv("ICED_PYTHON");
+	char* argv[] = {
+		(char*)(python != NULL ? python : "python3"),
+		(char*)"icworker.py",
+		(char*)g.world_module_name,
+		NULL,
+	};
+	const pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		dup2(req[0], 0);
+		dup2(rep[1], 1);
+		execvp(argv[0], argv);
+		_exit(127);
+	}
+	close(req[0]);
+	close(rep[1]);
+	fcntl(rep[0], F_SETFL, O_NONBLOCK);
+	w->pid = pid;
+	w->request_fd = req[1];
+	w->reply_fd = rep[0];
+	w->job = -1;
+	arrsetlen(w->reply_arr, 0);
+}
+
+// (re)starts the pool; workers import the world lazily, so this costs no more
+// than a few fork()s on the calling thread
+static void codegen_pool_restart(void)
+{
+	signal(SIGPIPE, SIG_IGN); // a dead worker shows up as EPIPE instead
+	for (int i = 0; i < arrlen(codegen_worker_arr); i++) {
+		codegen_worker_kill(&codegen_worker_arr[i]);
+	}
+	arrsetlen(codegen_worker_arr, g.codegen_n_workers);
+	for (int i = 0; i < arrlen(codegen_worker_arr); i++) {
+		struct codegen_worker* w = &codegen_worker_arr[i];
+		memset(w, 0, sizeof *w);
+		codegen_worker_spawn(w);
+	}
+}
+
+// returns true once a complete "<status> <size>\n<payload>" reply is buffered
+static bool codegen_worker_parse_reply(struct codegen_worker* w, bool* out_ok, char** out_payload, size_t* out_payload_size)
+{
+	const int n = arrlen(w->reply_arr);
+	char* nl = (char*)memchr(w->reply_arr, '\n', n);
+	if (nl == NULL) return false;
+	char status[16];
+	size_t size;
+	*nl = 0;
+	const bool valid = sscanf(w->reply_arr, "%15s %zu", status, &size) == 2;
+	*nl = '\n';
+	if (!valid) {
+		*out_ok = false;
+		*out_payload = cstrdup("malformed reply from codegen worker");
+		*out_payload_size = strlen(*out_payload);
+		return true;
+	}
+	const int header_size = (nl - w->reply_arr) + 1;
+	if ((size_t)(n - header_size) < size) return false;
+	*out_ok = strcmp(status, "ok") == 0;
+	*out_payload = (char*)malloc(size+1);
+	memcpy(*out_payload, w->reply_arr + header_size, size);
+	(*out_payload)[size] = 0;
+	*out_payload_size = size;
+	return true;
+}
+
+// runs the jobs on the worker pool, up to one in flight per worker, and calls
+// on_reply() on the calling thread as each finishes, so e.g. shader compiles
+// overlap with the codegen of the remaining views. a job whose worker hangs,
+// crashes or times out fails, and the worker is respawned
+static void codegen_run(struct codegen_job* jobs, int n_jobs, void(*on_reply)(struct codegen_job*))
+{
+	const int n_workers = arrlen(codegen_worker_arr);
+	assert(n_workers > 0);
+	int* state = (int*)calloc(n_jobs, sizeof *state); // 0=pending 1=running 2=done
+	int n_done = 0;
+	struct pollfd* pfds = (struct pollfd*)calloc(n_workers, sizeof *pfds);
+	double* elapsed = (double*)calloc(n_workers, sizeof *elapsed);
+	while (n_done < n_jobs) {
+		for (int wi = 0; wi < n_workers; wi++) {
+			struct codegen_worker* w = &codegen_worker_arr[wi];
+			if (w->job >= 0) continue;
+			for (int ji = 0; ji < n_jobs; ji++) {
+				struct codegen_job* job = &jobs[ji];
+				if (state[ji] != 0 || (job->worker >= 0 && job->worker != wi)) continue;
+				state[ji] = 1;
+				w->job = ji;
+				w->t0 = timer_begin();
+				arrsetlen(w->reply_arr, 0);
+				char line[sizeof job->request + 1];
+				const int n = snprintf(line, sizeof line, "%s\n", job->request);
+				if (write(w->request_fd, line, n) != n) {
+					// dead worker; the read below sees EOF and fails the job
+				}
+				break;
+			}
+		}
+
+		int timeout_ms = -1;
+		for (int wi = 0; wi < n_workers; wi++) {
+			struct codegen_worker* w = &codegen_worker_arr[wi];
+			pfds[wi].fd = w->job >= 0 ? w->reply_fd : -1;
+			pfds[wi].events = POLLIN;
+			pfds[wi].revents = 0;
+			if (w->job < 0) continue;
+			const int left_ms = (int)((CODEGEN_TIMEOUT - timer_end(w->t0)) * 1e3) + 1;
+			if (timeout_ms < 0 || left_ms < timeout_ms) timeout_ms = gb_max(0, left_ms);
+		}
+		poll(pfds, n_workers, timeout_ms);
+		// taken before any on_reply() so a compile doesn't count against the
+		// jobs that finished alongside it
+		for (int wi = 0; wi < n_workers; wi++) elapsed[wi] = timer_end(codegen_worker_arr[wi].t0);
+
+		for (int wi = 0; wi < n_workers; wi++) {
+			struct codegen_worker* w = &codegen_worker_arr[wi];
+			if (w->job < 0) continue;
+			struct codegen_job* job = &jobs[w->job];
+			const char* failure = NULL;
+			if (pfds[wi].revents != 0) {
+				char buf[1<<16];
+				ssize_t n;
+				while ((n = read(w->reply_fd, buf, sizeof buf)) > 0) {
+					memcpy(arraddnptr(w->reply_arr, n), buf, n);
+				}
+				if (codegen_worker_parse_reply(w, &job->ok, &job->payload, &job->payload_size)) {
+					job->duration = elapsed[wi];
+					state[w->job] = 2;
+					n_done++;
+					w->job = -1;
+					on_reply(job);
+					continue;
+				}
+				if (n == 0) failure = "codegen worker exited";
+			}
+			if (failure == NULL && elapsed[wi] > CODEGEN_TIMEOUT) {
+				failure = "codegen worker timed out";
+			}
+			if (failure == NULL) continue;
+			char msg[1<<10];
+			snprintf(msg, sizeof msg, "%s on `%s` (after %.1fs)\n", failure, job->request, elapsed[wi]);
+			job->ok = false;
+			job->payload = cstrdup(msg);
+			job->payload_size = strlen(msg);
+			job->duration = elapsed[wi];
+			state[w->job] = 2;
+			n_done++;
+			codegen_worker_kill(w);
+			codegen_worker_spawn(w);
+			on_reply(job);
+		}
+	}
+	free(elapsed);
+	free(pfds);
+	free(state);
+}
+
+// the view_gen in the payload of a successful "view" job; it points into the
+// payload
+static struct view_gen view_gen_from_reply(const struct codegen_job* job)
+{
+	// "<source>\0<fallback>\0<stats>\0<ir>", see icworker.py
+	const char* fields[3];
+	size_t offset = 0;
+	for (int i = 0; i < 3; i++) {
+		fields[i] = offset < job->payload_size ? job->payload + offset : "";
+		offset = gb_min(offset + strlen(fields[i]) + 1, job->payload_size);
+	}
+	struct view_gen gen = {fields[0], fields[1], fields[2], job->payload + offset, job->payload_size - offset};
+	return gen;
+}
+
+static void on_view_reply(struct codegen_job* job)
+{
+	if (job->ok) {
+		const struct view_gen gen = view_gen_from_reply(job);
+		update_view(job->view, &gen, job->duration);
+	} else {
+		raise_errorf("view `%s` failed:\n%s", job->view->name, job->payload);
+	}
+}
+
+// calls the view's constructor in-process and passes what it returned to
+// on_gen(); false, with the Python error left set, if it raised
+static bool codegen_view_inprocess(struct view* view, void(*on_gen)(struct view*, const struct view_gen*, double))
+{
+	struct timespec t0 = timer_begin();
+	PyObject* pview = PyObject_GetAttrString(g.python_world_module, view->name);
+	PyObject* r = pview != NULL ? PyObject_CallObject(pview, NULL) : NULL;
+	Py_XDECREF(pview);
+	if (r == NULL) return false;
+	PyObject* psource = PyObject_GetAttrString(r, "source");
+	PyObject* pfallback = PyObject_GetAttrString(r, "fallback");
+	PyObject* pstats = PyObject_GetAttrString(r, "stats");
+	PyObject* pir = PyObject_GetAttrString(r, "ir");
+	Py_DECREF(r);
+	Py_buffer ir = {0};
+	if (pir == NULL || PyObject_GetBuffer(pir, &ir, PyBUF_SIMPLE) != 0) {
+		PyErr_Clear();
+	}
+	struct view_gen gen = {
+		PyUnicode_AsUTF8(psource),
+		pfallback != NULL ? PyUnicode_AsUTF8(pfallback) : "",
+		pstats != NULL ? PyUnicode_AsUTF8(pstats) : "",
+		ir.buf,
+		(size_t)ir.len,
+	};
+	PyErr_Clear();
+	on_gen(view, &gen, timer_end(t0));
+	if (ir.obj != NULL) PyBuffer_Release(&ir);
+	Py_XDECREF(pir);
+	Py_XDECREF(pstats);
+	Py_XDECREF(pfallback);
 	Py_DECREF(psource);
+	return true;
+}
+
+static void reload_view_inprocess(struct view* view)
+{
+	if (!codegen_view_inprocess(view, update_view)) handle_python_error();
+}
+
+static void reload_views(struct view** views, int n_views)
+{
+	struct timespec t0 = timer_begin();
+	g.duration_compile = 0;
+	if (arrlen(codegen_worker_arr) == 0) {
+		for (int i = 0; i < n_views; i++) reload_view_inprocess(views[i]);
+	} else {
+		struct codegen_job* jobs = (struct codegen_job*)calloc(n_views, sizeof *jobs);
+		for (int i = 0; i < n_views; i++) {
+			struct codegen_job* job = &jobs[i];
+			snprintf(job->request, sizeof job->request, "view %s", views[i]->name);
+			job->worker = -1;
+			job->view = views[i];
+		}
+		codegen_run(jobs, n_views, on_view_reply);
+		for (int i = 0; i < n_views; i++) free(jobs[i].payload);
+		free(jobs);
+	}
+	// with workers codegen overlaps compiles; count what wasn't compiling
+	g.duration_exec = timer_end(t0) - g.duration_compile;
+}
+
+static void reload_view(struct view* view)
+{
+	reload_views(&view, 1);
+}
+
+static void on_import_reply(struct codegen_job* job)
+{
+	if (!job->ok) raise_errorf("world-import failed:\n%s", job->payload);
+}
+
+// has every worker import (or soft reload) the world; false on failure
+static bool codegen_import(void)
+{
+	const int n = arrlen(codegen_worker_arr);
+	struct codegen_job* jobs = (struct codegen_job*)calloc(n, sizeof *jobs);
+	for (int i = 0; i < n; i++) {
+		snprintf(jobs[i].request, sizeof jobs[i].request, "import");
+		jobs[i].worker = i;
+	}
+	codegen_run(jobs, n, on_import_reply);
+	bool ok = true;
+	for (int i = 0; i < n; i++) {
+		ok = ok && jobs[i].ok;
+		free(jobs[i].payload);
+	}
+	free(jobs);
+	return ok;
+}
+
+// the world runs in a subinterpreter. a hard reload switches to a fresh one
+// (normally pre-warmed, see python_housekeeping()) and retires the old one,
+// so neither Py_NewInterpreter() nor Py_EndInterpreter() runs on the UI
+// thread. for the housekeeping thread to make progress the UI thread only
+// holds the GIL between python_acquire() and python_release(), i.e. during
+// iced_gui() and the headless entry points.
+static void python_acquire(void)
+{
+	if (g.python_holding_gil || g.python_tstate == NULL) return;
+	PyEval_RestoreThread(g.python_tstate);
+	g.python_holding_gil = true;
+}
+
+static void python_release(void)
+{
+	if (!g.python_holding_gil) return;
+	PyEval_SaveThread();
+	g.python_holding_gil = false;
+}
+
+static PyThreadState* python_new_interpreter(void)
+{
+	PyThreadState* prev = PyThreadState_Get();
+	PyThreadState* tstate = Py_NewInterpreter();
+	if (tstate != NULL) {
+		PyRun_SimpleString(
+			"import sys\n"
+			"sys.path.insert(0,'')\n" // ensure local modules can be imported
+			"import os, gc, traceback\n" // warm up what iclib and the error path need
+		);
+	}
+	PyThreadState_Swap(prev);
+	return tstate;
+}
+
+// one job per GIL hold, while the UI stays idle: end a retired interpreter,
+// or pre-warm the next one
+static void* python_housekeeping_thread(void* arg)
+{
+	(void)arg;
+	PyGILState_STATE gstate = PyGILState_Ensure();
+	PyThreadState* own = PyThreadState_Get();
+	for (;;) {
+		if (g.python_idle_frames < PYTHON_IDLE_FRAMES) break;
+		if (arrlen(g.python_retired_arr) > 0) {
+			// Py_EndInterpreter() wants the interpreter's last thread state
+			struct python_interp old = arrpop(g.python_retired_arr);
+			PyThreadState_Swap(old.created);
+			PyThreadState_Clear(old.ui);
+			PyThreadState_Delete(old.ui);
+			Py_EndInterpreter(old.created);
+			PyThreadState_Swap(own);
+		} else if (g.python_spare_tstate == NULL && g.python_tstate != NULL) {
+			g.python_spare_tstate = python_new_interpreter();
+		} else {
+			break;
+		}
+		// let a frame that wants Python in
+		PyGILState_Release(gstate);
+		gstate = PyGILState_Ensure();
+		own = PyThreadState_Get();
+	}
+	g.python_housekeeping_busy = false;
+	PyGILState_Release(gstate);
+	return NULL;
+}
+
+// ending an interpreter (module teardown and GC of the old world) and making
+// a new one hold the GIL throughout, and in 3.11 the GIL is shared by all
+// interpreters: a frame that wants Python meanwhile waits for it, which for
+// a large world is hundreds of milliseconds. so it's left until the UI has
+// been idle for PYTHON_IDLE_FRAMES; input arriving in the middle of a job
+// still waits for the rest of that job
+static void python_housekeeping(void)
+{
+	if (g.python_housekeeping_busy || g.python_idle_frames < PYTHON_IDLE_FRAMES) return;
+	if (arrlen(g.python_retired_arr) == 0 && (g.python_spare_tstate != NULL || g.python_tstate == NULL)) return;
+	g.python_housekeeping_busy = true;
+	pthread_t thread;
+	assert(pthread_create(&thread, NULL, python_housekeeping_thread, NULL) == 0);
+	pthread_detach(thread);
 }
 
 static void reload_script(void)
@@ -534,25 +1565,51 @@ static void reload_script(void)
 	const bool must_init = !g.python_initialized || g.python_do_reinitialize;
 	g.python_do_reinitialize = false;
 	struct timespec t0 = timer_begin();
-	if (must_init && g.python_initialized) {
-		assert(!(Py_FinalizeEx() < 0));
-		g.python_initialized = false;
-	}
 
 	if (must_init) {
-		assert(!g.python_initialized);
-		Py_Initialize();
+		if (!Py_IsInitialized()) {
+			// the main interpreter stays idle; see python_acquire()
+			Py_Initialize();
+			g.python_holding_gil = true;
+		}
+		python_acquire();
+		PyThreadState* old = g.python_tstate;
+		if (old != NULL) {
+			Py_CLEAR(g.python_world_module);
+			Py_CLEAR(g.python_iclib_module);
+		}
+		PyThreadState* created = g.python_spare_tstate;
+		g.python_spare_tstate = NULL;
+		if (created == NULL) created = python_new_interpreter();
+		assert((created != NULL) && "failed to create subinterpreter");
+		// a spare's state belongs to the housekeeping thread that made it;
+		// the UI thread runs the interpreter with a state of its own, and
+		// the housekeeping thread ends it with the one it made
+		PyThreadState* tstate = PyThreadState_New(PyThreadState_GetInterpreter(created));
+		assert((tstate != NULL) && "failed to create thread state");
+		PyThreadState_Swap(tstate);
+		if (old != NULL) {
+			struct python_interp retired = { g.python_created_tstate, old };
+			arrput(g.python_retired_arr, retired);
+		}
+		g.python_tstate = tstate;
+		g.python_created_tstate = created;
 		g.python_initialized = true;
-		PyRun_SimpleString(
-			"import sys\n"
-			"sys.path.insert(0,'')\n" // ensure local modules can be imported
-		);
+		if (g.codegen_n_workers > 0) codegen_pool_restart();
 	}
 
 	assert(g.python_initialized);
 
+	// the workers import first, so a world that fails or hangs on import is
+	// caught (and killed) there before it's imported in-process below
+	if (arrlen(codegen_worker_arr) > 0 && !codegen_import()) {
+		g.python_initialized = false; // as handle_python_error() would
+		g.duration_load = timer_end(t0);
+		return;
+	}
+
 	if (must_init) {
-		PyObject* pn = PyUnicode_DecodeFSDefault("world");
+		PyObject* pn = PyUnicode_DecodeFSDefault(g.world_module_name);
 		g.python_world_module = PyImport_Import(pn);
 		Py_DECREF(pn);
 		if (g.python_world_module != NULL) {
@@ -607,14 +1664,22 @@ static void reload_script(void)
 
 	g.duration_load = timer_end(t0);
 
-	for (int i = 0; i < arrlen(view_arr); i++) {
-		struct view* view = &view_arr[i];
-		reload_view(view);
-	}
+	struct view** views = NULL;
+	for (int i = 0; i < arrlen(view_arr); i++) arrput(views, &view_arr[i]);
+	reload_views(views, arrlen(views));
+	arrfree(views);
+	g.world_serial = next_serial();
 }
 
 static void check_for_reload(void)
 {
+	if (g.watch_disabled) {
+		if (!g.reload_requested) return;
+		g.reload_requested = false;
+		reload_script();
+		return;
+	}
+
 	const char* p0 = g.watch_paths_arr;
 	const char* p1 = p0 + arrlen(p0);
 	const char* p = p0;
@@ -633,12 +1698,57 @@ static void check_for_reload(void)
 	if (!reload) return;
 
 	reload_script();
+	g.watch_reloaded = true;
+}
+
+bool iced_watch_reloaded(void)
+{
+	const bool r = g.watch_reloaded;
+	g.watch_reloaded = false;
+	return r;
+}
+
+void iced_set_watch(bool enable)
+{
+	g.watch_disabled = !enable;
+}
+
+void iced_request_reload(void)
+{
+	g.reload_requested = true;
+}
+
+void iced_set_world(const char* module_name)
+{
+	g.world_module_name = module_name;
+}
+
+void iced_set_codegen_workers(int n)
+{
+	g.codegen_n_workers = n;
+}
+
+void iced_set_glsl_budget(int soft_lines, int hard_lines)
+{
+	g.glsl_budget_soft = soft_lines;
+	g.glsl_budget_hard = hard_lines;
 }
 
 void iced_init(void)
 {
+	if (g.world_module_name == NULL) g.world_module_name = "world";
+	if (g.codegen_n_workers < 0) g.codegen_n_workers = gb_clamp(sysconf(_SC_NPROCESSORS_ONLN), 1, 4);
+	if (g.glsl_budget_hard <= 0) iced_set_glsl_budget(20000, 100000);
+	g.offline.size[0] = 7680;
+	g.offline.size[1] = 4320;
+	g.offline.tile_size = 256;
+	g.offline.aa = 3;
+	g.sequence.size[0] = 1920;
+	g.sequence.size[1] = 1080;
+	g.sequence.n_frames = 120;
 	reload_script();
 	glGenVertexArrays(1, &g.vao0); CHKGL;
+	python_release();
 }
 
 static struct view* get_view_window_view(struct view_window* vw)
@@ -653,9 +1763,624 @@ static struct view* get_view_window_view(struct view_window* vw)
 	assert(!"no view?!");
 }
 
-static void window_view(struct view_window* vw)
+static int render_target_bucket(int n)
 {
-	struct view* view = get_view_window_view(vw);
+	// quarter-octave steps, i.e. p/8 between p/2 and p: never more than
+	// ~25% wasted per axis (steps below 32 pixels aren't worth it)
+	int p = 64;
+	while (p < n) p <<= 1;
+	const int step = gb_max(p/8, 32);
+	return ((n + step - 1) / step) * step;
+}
+
+static size_t render_target_bytes(const struct render_target* rt)
+{
+	const size_t bytes_per_pixel = rt->gbuffer_framebuffer != 0 ? 4+16+16 : 4;
+	return (size_t)rt->width * (size_t)rt->height * bytes_per_pixel;
+}
+
+static bool render_target_fits(int index, int width, int height)
+{
+	if (index < 0) return false;
+	const struct render_target* rt = &render_target_arr[index];
+	return width <= rt->width && height <= rt->height && render_target_bucket(width) == rt->width && render_target_bucket(height) == rt->height;
+}
+
+static void render_target_release(int index)
+{
+	if (index < 0) return;
+	struct render_target* rt = &render_target_arr[index];
+	assert(rt->in_use);
+	rt->in_use = false;
+	rt->last_used_frame = g.frame;
+}
+
+// releases least recently used free targets until the pool fits the budget
+static void render_target_trim(size_t budget)
+{
+	for (;;) {
+		size_t total = 0;
+		int lru = -1;
+		for (int i = 0; i < arrlen(render_target_arr); i++) {
+			struct render_target* rt = &render_target_arr[i];
+			if (rt->texture == 0) continue;
+			total += render_target_bytes(rt);
+			if (rt->in_use) continue;
+			if (lru < 0 || rt->last_used_frame < render_target_arr[lru].last_used_frame) lru = i;
+		}
+		if (total <= budget || lru < 0) break;
+		struct render_target* rt = &render_target_arr[lru];
+		glDeleteTextures(1, &rt->texture); CHKGL;
+		glDeleteFramebuffers(1, &rt->framebuffer); CHKGL;
+		if (rt->gbuffer_framebuffer != 0) {
+			glDeleteTextures(2, rt->gbuffer_textures); CHKGL;
+			glDeleteFramebuffers(1, &rt->gbuffer_framebuffer); CHKGL;
+		}
+		memset(rt, 0, sizeof *rt);
+	}
+}
+
+static int render_target_acquire(int width, int height)
+{
+	const int bw = render_target_bucket(width);
+	const int bh = render_target_bucket(height);
+	const int n = arrlen(render_target_arr);
+	int found = -1;
+	int empty = -1;
+	for (int i = 0; i < n; i++) {
+		struct render_target* rt = &render_target_arr[i];
+		if (rt->texture == 0) {
+			if (empty < 0) empty = i;
+			continue;
+		}
+		if (rt->in_use || rt->width != bw || rt->height != bh) continue;
+		if (found < 0 || rt->last_used_frame > render_target_arr[found].last_used_frame) found = i;
+	}
+
+	if (found < 0) {
+		if (empty < 0) {
+			struct render_target rt = {0};
+			arrput(render_target_arr, rt);
+			empty = n;
+		}
+		found = empty;
+		struct render_target* rt = &render_target_arr[found];
+		rt->width = bw;
+		rt->height = bh;
+		glGenTextures(1, &rt->texture); CHKGL;
+		glBindTexture(GL_TEXTURE_2D, rt->texture); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
+		glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB, bw, bh, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, NULL); CHKGL;
+		glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+		glGenFramebuffers(1, &rt->framebuffer); CHKGL;
+		glBindFramebuffer(GL_FRAMEBUFFER, rt->framebuffer); CHKGL;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rt->texture, /*level=*/0); CHKGL;
+		assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+	}
+
+	struct render_target* rt = &render_target_arr[found];
+	rt->in_use = true;
+	rt->last_used_frame = g.frame;
+	return found;
+}
+
+// framebuffer for FRAGMENT_MAIN_3D's geometry pass, the size of the target
+static GLuint render_target_gbuffer(int index)
+{
+	struct render_target* rt = &render_target_arr[index];
+	if (rt->gbuffer_framebuffer != 0) return rt->gbuffer_framebuffer;
+	glGenTextures(2, rt->gbuffer_textures); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, rt->gbuffer_textures[0]); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGBA32F, rt->width, rt->height, /*border=*/0, GL_RGBA, GL_FLOAT, NULL); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, rt->gbuffer_textures[1]); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGBA32I, rt->width, rt->height, /*border=*/0, GL_RGBA_INTEGER, GL_INT, NULL); CHKGL;
+	for (int i = 0; i < 2; i++) {
+		// read with texelFetch() only
+		glBindTexture(GL_TEXTURE_2D, rt->gbuffer_textures[i]); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	glGenFramebuffers(1, &rt->gbuffer_framebuffer); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, rt->gbuffer_framebuffer); CHKGL;
+	for (int i = 0; i < 2; i++) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0+i, GL_TEXTURE_2D, rt->gbuffer_textures[i], /*level=*/0); CHKGL;
+	}
+	const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, draw_buffers); CHKGL;
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+	return rt->gbuffer_framebuffer;
+}
+
+static void render_result_set_key(struct render_result* rr, struct view* view, struct view_window* vw, int width, int height)
+{
+	assert(view->dim == 3);
+	rr->view_serial = view->serial;
+	rr->width = width;
+	rr->height = height;
+	rr->pixel_size = vw->pixel_size;
+	memset(&rr->cam, 0, sizeof rr->cam);
+	rr->cam.origin = vw->d3.origin;
+	rr->cam.fov = vw->d3.fov;
+	rr->cam.pitch = vw->d3.pitch;
+	rr->cam.yaw = vw->d3.yaw;
+	rr->lighting = vw->lighting;
+	rr->march = vw->march;
+}
+
+static void march_reset(struct march* m)
+{
+	memset(m, 0, sizeof *m);
+	m->kernel = MARCH_PLAIN;
+	m->relaxation = 1.6f;
+	m->far = 100.0f;
+	m->max_steps = 256;
+}
+
+static bool march_equal(const struct march* a, const struct march* b)
+{
+	return
+		a->kernel == b->kernel &&
+		a->relaxation == b->relaxation &&
+		a->adaptive_epsilon == b->adaptive_epsilon &&
+		a->far == b->far &&
+		a->max_steps == b->max_steps;
+}
+
+// a headlight where the old hardcoded light was, soft shadows and a little AO
+static void lighting_reset(struct lighting* l)
+{
+	memset(l, 0, sizeof *l);
+	l->lights[0].enabled = true;
+	l->lights[0].follow_camera = true;
+	l->lights[0].position = gb_vec3(0,0,-4);
+	l->lights[0].color = gb_vec3(30,30,30);
+	l->ambient = 0.15f;
+	l->shadow_steps = 32;
+	l->penumbra = 16.0f;
+	l->ao_taps = 5;
+	l->ao_step = 0.1f;
+	l->shading = SHADING_LIT;
+	l->exposure = 1.0f;
+	l->heat_max = 256;
+}
+
+static bool lighting_equal(const struct lighting* a, const struct lighting* b)
+{
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		const struct light* la = &a->lights[i];
+		const struct light* lb = &b->lights[i];
+		if (la->enabled != lb->enabled) return false;
+		if (!la->enabled) continue;
+		if (la->follow_camera != lb->follow_camera) return false;
+		if (memcmp(&la->position, &lb->position, sizeof la->position) != 0) return false;
+		if (memcmp(&la->color, &lb->color, sizeof la->color) != 0) return false;
+	}
+	return
+		a->ambient == b->ambient &&
+		a->shadow_steps == b->shadow_steps &&
+		a->penumbra == b->penumbra &&
+		a->ao_taps == b->ao_taps &&
+		a->ao_step == b->ao_step &&
+		a->shading == b->shading &&
+		a->exposure == b->exposure &&
+		a->tonemap == b->tonemap &&
+		a->heat_max == b->heat_max;
+}
+
+// equal up to the lighting, i.e. same G-buffer
+static bool render_result_geometry_equal(const struct render_result* a, const struct render_result* b)
+{
+	return
+		a->view_serial == b->view_serial &&
+		a->width == b->width &&
+		a->height == b->height &&
+		a->pixel_size == b->pixel_size &&
+		memcmp(&a->cam, &b->cam, sizeof a->cam) == 0 &&
+		march_equal(&a->march, &b->march);
+}
+
+static bool render_result_key_equal(const struct render_result* a, const struct render_result* b)
+{
+	return
+		render_result_geometry_equal(a, b) &&
+		lighting_equal(&a->lighting, &b->lighting);
+}
+
+// whether a view window other than vw shows render result index
+static bool render_result_shared(int index, const struct view_window* vw)
+{
+	for (int i = 0; i < arrlen(view_window_arr); i++) {
+		const struct view_window* vw2 = &view_window_arr[i];
+		if (vw2 != vw && vw2->render_result == index) return true;
+	}
+	return false;
+}
+
+// points vw->render_result at a render result matching the 3D view, camera
+// and resolution; either an existing one or a new one that is rendered in the
+// next iced_render()
+static void acquire_render_result(struct view_window* vw, struct view* view, int fb_width, int fb_height)
+{
+	struct render_result key = {0};
+	render_result_set_key(&key, view, vw, fb_width, fb_height);
+
+	const int n = arrlen(render_result_arr);
+	int found = -1;
+	for (int i = 0; i < n; i++) {
+		struct render_result* rr = &render_result_arr[i];
+		if (rr->in_use && render_result_key_equal(rr, &key)) {
+			found = i;
+			break;
+		}
+	}
+
+	if (found < 0 && vw->render_result >= 0) {
+		// only the lighting changed? then reshade our G-buffer rather
+		// than march again, unless another window still shows the result
+		struct render_result* rr = &render_result_arr[vw->render_result];
+		if (rr->in_use && render_result_geometry_equal(rr, &key) && !render_result_shared(vw->render_result, vw)) {
+			rr->lighting = key.lighting;
+			rr->reshade = true;
+			rr->owner = vw - view_window_arr;
+			found = vw->render_result;
+		}
+	}
+
+	if (found < 0) {
+		// recycle our own slot, unless another window shows it too,
+		// or else the oldest one no other window points at; one that a
+		// window later in the frame hasn't looked up yet may well still
+		// be current for it
+		const int own = vw->render_result;
+		const bool recycle_own = own >= 0 && own < n && render_result_arr[own].in_use && !render_result_shared(own, vw);
+		if (recycle_own) found = own;
+		for (int i = 0; i < n && !recycle_own; i++) {
+			struct render_result* rr = &render_result_arr[i];
+			if (rr->last_used_frame >= g.frame) continue;
+			if (rr->in_use && render_result_shared(i, vw)) continue;
+			if (found < 0 || rr->last_used_frame < render_result_arr[found].last_used_frame) {
+				found = i;
+			}
+		}
+		if (found < 0) {
+			struct render_result rr = {0};
+			rr.target = -1;
+			arrput(render_result_arr, rr);
+			found = n;
+		}
+		struct render_result* rr = &render_result_arr[found];
+		render_result_set_key(rr, view, vw, fb_width, fb_height);
+		rr->in_use = true;
+		rr->dirty = true;
+		rr->has_cost = false;
+		rr->owner = vw - view_window_arr;
+		if (!render_target_fits(rr->target, fb_width, fb_height)) {
+			// acquired here rather than in iced_render() because the
+			// texture name goes into the draw list first
+			render_target_release(rr->target);
+			rr->target = render_target_acquire(fb_width, fb_height);
+		}
+	}
+
+	// UVs of the used part of the target
+	const struct render_result* rr = &render_result_arr[found];
+	const struct render_target* rt = &render_target_arr[rr->target];
+	render_result_arr[found].last_used_frame = g.frame;
+	vw->render_result = found;
+	vw->uv0 = ImVec2(0,0);
+	vw->uv1 = ImVec2((float)rr->width / (float)rt->width, (float)rr->height / (float)rt->height);
+}
+
+static void tile_key_init(struct tile_key* key, uint64_t view_serial, int level, int x, int y)
+{
+	memset(key, 0, sizeof *key);
+	key->view_serial = view_serial;
+	key->level = level;
+	key->x = x;
+	key->y = y;
+}
+
+// tile coordinate k levels up, i.e. floor(i / 2^k)
+static inline int tile_coord_up(int i, int k)
+{
+	return i >= 0 ? i >> k : -((-i - 1) >> k) - 1;
+}
+
+static void tile_atlas_init(void)
+{
+	if (g.tile_atlas != 0) return;
+	glGenTextures(1, &g.tile_atlas); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, g.tile_atlas); CHKGL;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); CHKGL;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB, TILE_ATLAS_SIZE, TILE_ATLAS_SIZE, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, NULL); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	glGenFramebuffers(1, &g.tile_framebuffer); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, g.tile_framebuffer); CHKGL;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g.tile_atlas, /*level=*/0); CHKGL;
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+
+	glGenBuffers(1, &g.tile_draw_buffer); CHKGL;
+	glBindBuffer(GL_UNIFORM_BUFFER, g.tile_draw_buffer); CHKGL;
+	glBufferData(GL_UNIFORM_BUFFER, TILE_BUDGET * 2 * sizeof(gbVec4), NULL, GL_DYNAMIC_DRAW); CHKGL;
+	glBindBuffer(GL_UNIFORM_BUFFER, 0); CHKGL;
+
+	const int n = TILE_ATLAS_SLOTS * TILE_ATLAS_SLOTS;
+	arrsetlen(tile_arr, n);
+	memset(tile_arr, 0, n * sizeof *tile_arr);
+}
+
+// tile_arr index of a tile that is rendered or will be in this frame's
+// tile_cache_render(), or -1. a cached tile is kept from eviction for the rest
+// of the frame either way
+static int tile_lookup(const struct tile_key* key)
+{
+	const ptrdiff_t i = hmgeti(tile_map, *key);
+	if (i < 0) return -1;
+	const int index = tile_map[i].value;
+	struct tile* t = &tile_arr[index];
+	t->last_used_frame = g.frame;
+	return t->ready || t->scheduled ? index : -1;
+}
+
+// gives a missing tile a slot, evicting the least recently used tile not used
+// this frame when the atlas is full, and schedules it for this frame's
+// tile_cache_render() while the frame's TILE_BUDGET lasts. returns its
+// tile_arr index when scheduled, otherwise -1; it's up to the caller to ask
+// again in the next frame
+static int tile_request(struct view* view, const struct tile_key* key)
+{
+	tile_atlas_init();
+	const ptrdiff_t i = hmgeti(tile_map, *key);
+	int index = -1;
+	if (i >= 0) {
+		index = tile_map[i].value;
+	} else {
+		const int n = arrlen(tile_arr);
+		for (int j = 0; j < n; j++) {
+			const struct tile* t = &tile_arr[j];
+			if (!t->in_use) {
+				index = j;
+				break;
+			}
+			if (t->last_used_frame >= g.frame) continue;
+			if (index < 0 || t->last_used_frame < tile_arr[index].last_used_frame) index = j;
+		}
+		if (index < 0) return -1; // every slot is on screen already
+		struct tile* t = &tile_arr[index];
+		if (t->in_use) hmdel(tile_map, t->key);
+		memset(t, 0, sizeof *t);
+		t->in_use = true;
+		t->key = *key;
+		hmput(tile_map, t->key, index);
+	}
+	struct tile* t = &tile_arr[index];
+	t->last_used_frame = g.frame;
+	if (t->ready || t->scheduled) return index;
+	if (g.tiles_frame != g.frame) {
+		g.tiles_frame = g.frame;
+		g.n_tiles_scheduled = 0;
+	}
+	if (g.n_tiles_scheduled >= TILE_BUDGET) return -1;
+	g.n_tiles_scheduled++;
+	t->scheduled = true;
+	t->view = view - view_arr;
+	return index;
+}
+
+// draws the f0-f1 part (in [0;1] tile units) of the tile at index to p0-p1
+static void draw_tile(ImDrawList* draw_list, int index, ImVec2 p0, ImVec2 p1, ImVec2 f0, ImVec2 f1)
+{
+	const float s = 1.0f / (float)TILE_ATLAS_SIZE;
+	const float ax = (float)((index % TILE_ATLAS_SLOTS) * TILE_SLOT + 1);
+	const float ay = (float)((index / TILE_ATLAS_SLOTS) * TILE_SLOT + 1);
+	const ImVec2 uv0 = ImVec2((ax + f0.x*TILE_SIZE) * s, (ay + f0.y*TILE_SIZE) * s);
+	const ImVec2 uv1 = ImVec2((ax + f1.x*TILE_SIZE) * s, (ay + f1.y*TILE_SIZE) * s);
+	draw_list->AddImage((void*)(intptr_t)g.tile_atlas, p0, p1, uv0, uv1);
+}
+
+// draws level tile (x,y) at s0-s1 from the nearest coarser cached level, or
+// else from the level below; with draw_list NULL it only keeps those tiles
+// from eviction
+static void draw_tile_fallback(ImDrawList* draw_list, uint64_t view_serial, int level, int x, int y, ImVec2 s0, ImVec2 s1)
+{
+	for (int k = 1; k <= TILE_FALLBACK_LEVELS; k++) {
+		const int px = tile_coord_up(x, k);
+		const int py = tile_coord_up(y, k);
+		struct tile_key key;
+		tile_key_init(&key, view_serial, level+k, px, py);
+		const int index = tile_lookup(&key);
+		if (index < 0) continue;
+		const float n = (float)(1<<k);
+		const float fx = (float)(x - px*(1<<k));
+		const float fy = (float)(y - py*(1<<k));
+		if (draw_list != NULL) draw_tile(draw_list, index, s0, s1, ImVec2(fx/n, fy/n), ImVec2((fx+1)/n, (fy+1)/n));
+		return;
+	}
+
+	const ImVec2 sm = ImVec2((s0.x+s1.x)*0.5f, (s0.y+s1.y)*0.5f);
+	for (int c = 0; c < 4; c++) {
+		struct tile_key key;
+		tile_key_init(&key, view_serial, level-1, 2*x + (c&1), 2*y + (c>>1));
+		const int index = tile_lookup(&key);
+		if (index < 0 || draw_list == NULL) continue;
+		const ImVec2 c0 = ImVec2(c&1 ? sm.x : s0.x, c>>1 ? sm.y : s0.y);
+		const ImVec2 c1 = ImVec2(c&1 ? s1.x : sm.x, c>>1 ? s1.y : sm.y);
+		draw_tile(draw_list, index, c0, c1, ImVec2(0,0), ImVec2(1,1));
+	}
+}
+
+struct missing_tile {
+	int x, y;
+	ImVec2 s0, s1;
+	float priority; // lower is requested first
+};
+
+static int missing_tile_compar(const void* a, const void* b)
+{
+	const float pa = ((const struct missing_tile*)a)->priority;
+	const float pb = ((const struct missing_tile*)b)->priority;
+	return pa < pb ? -1 : pa > pb ? 1 : 0;
+}
+
+// draws the canvas of a 2D view window from the tile cache, at the level
+// whose texels are at most a window pixel wide. missing tiles are requested
+// nearest the center first; those that don't make this frame's budget are
+// drawn from other levels meanwhile (draw_tile_fallback())
+static void draw_view_tiles(struct view* view, struct view_window* vw, ImDrawList* draw_list, ImVec2 p0, ImVec2 size)
+{
+	const double scale = vw->d2.scale; // world units per screen pixel
+	const int level = (int)floor(log2(scale * (double)(vw->pixel_size+1)));
+	const double tile_size = ldexp((double)TILE_SIZE, level);
+	const double ox = vw->d2.origin.x;
+	const double oy = vw->d2.origin.y;
+	const double cx = p0.x + size.x*0.5;
+	const double cy = p0.y + size.y*0.5;
+	const double fx0 = floor((ox - size.x*0.5*scale) / tile_size);
+	const double fy0 = floor((oy - size.y*0.5*scale) / tile_size);
+	const double fx1 = floor((ox + size.x*0.5*scale) / tile_size);
+	const double fy1 = floor((oy + size.y*0.5*scale) / tile_size);
+	const double lim = (double)(1<<30);
+	if (fabs(fx0) > lim || fabs(fy0) > lim || fabs(fx1) > lim || fabs(fy1) > lim) return;
+	const int x0 = (int)fx0, y0 = (int)fy0, x1 = (int)fx1, y1 = (int)fy1;
+
+	static struct missing_tile* missing_arr;
+	arrsetlen(missing_arr, 0);
+
+	draw_list->PushClipRect(p0, ImVec2(p0.x + size.x, p0.y + size.y), true);
+	for (int y = y0; y <= y1; y++) {
+		for (int x = x0; x <= x1; x++) {
+			// screen rectangle; computed the same way for every tile so
+			// that neighbours share their edges exactly
+			const ImVec2 s0 = ImVec2((float)(cx + ((double)x*tile_size - ox) / scale), (float)(cy + ((double)y*tile_size - oy) / scale));
+			const ImVec2 s1 = ImVec2((float)(cx + ((double)(x+1)*tile_size - ox) / scale), (float)(cy + ((double)(y+1)*tile_size - oy) / scale));
+			struct tile_key key;
+			tile_key_init(&key, view->serial, level, x, y);
+			const int index = tile_lookup(&key);
+			if (index >= 0) {
+				draw_tile(draw_list, index, s0, s1, ImVec2(0,0), ImVec2(1,1));
+				continue;
+			}
+			const float dx = (float)(x - (x0+x1)*0.5);
+			const float dy = (float)(y - (y0+y1)*0.5);
+			struct missing_tile mt = { .x = x, .y = y, .s0 = s0, .s1 = s1, .priority = dx*dx + dy*dy };
+			arrput(missing_arr, mt);
+			// claim the fallbacks before any request can evict them
+			draw_tile_fallback(NULL, view->serial, level, x, y, s0, s1);
+		}
+	}
+
+	const int n = arrlen(missing_arr);
+	qsort(missing_arr, n, sizeof *missing_arr, missing_tile_compar);
+	for (int i = 0; i < n; i++) {
+		const struct missing_tile* mt = &missing_arr[i];
+		struct tile_key key;
+		tile_key_init(&key, view->serial, level, mt->x, mt->y);
+		const int index = tile_request(view, &key);
+		if (index >= 0) {
+			draw_tile(draw_list, index, mt->s0, mt->s1, ImVec2(0,0), ImVec2(1,1));
+		} else {
+			draw_tile_fallback(draw_list, view->serial, level, mt->x, mt->y, mt->s0, mt->s1);
+		}
+	}
+	draw_list->PopClipRect();
+}
+
+static float catmull_rom(float p0, float p1, float p2, float p3, float t)
+{
+	const float t2 = t*t;
+	const float t3 = t2*t;
+	return 0.5f * (
+		(2.0f*p1) +
+		(-p0 + p2) * t +
+		(2.0f*p0 - 5.0f*p1 + 4.0f*p2 - p3) * t2 +
+		(-p0 + 3.0f*p1 - 3.0f*p2 + p3) * t3);
+}
+
+// camera at u in [0;1] along a Catmull-Rom spline through the keys; keys are
+// spaced evenly in time
+static struct camera_key camera_path_eval(const struct camera_key* keys, int n, float u)
+{
+	assert(n > 0);
+	if (n == 1) return keys[0];
+	const float s = gb_clamp(u, 0.0f, 1.0f) * (float)(n-1);
+	const int i = gb_min((int)s, n-2);
+	const float t = s - (float)i;
+	const struct camera_key* k0 = &keys[gb_max(i-1, 0)];
+	const struct camera_key* k1 = &keys[i];
+	const struct camera_key* k2 = &keys[i+1];
+	const struct camera_key* k3 = &keys[gb_min(i+2, n-1)];
+	struct camera_key k;
+	for (int j = 0; j < 3; j++) {
+		k.origin.e[j] = catmull_rom(k0->origin.e[j], k1->origin.e[j], k2->origin.e[j], k3->origin.e[j], t);
+	}
+	k.fov = catmull_rom(k0->fov, k1->fov, k2->fov, k3->fov, t);
+	k.pitch = catmull_rom(k0->pitch, k1->pitch, k2->pitch, k3->pitch, t);
+	k.yaw = catmull_rom(k0->yaw, k1->yaw, k2->yaw, k3->yaw, t);
+	return k;
+}
+
+// replaces the path with a full orbit of the current camera around the z
+// axis
+static void camera_path_turntable(struct view_window* vw)
+{
+	arrsetlen(vw->camera_key_arr, 0);
+	const int n = 8;
+	for (int i = 0; i <= n; i++) {
+		const float a = GB_MATH_TAU * (float)i / (float)n;
+		const float c = cosf(a);
+		const float s = sinf(a);
+		const gbVec3 o = vw->d3.origin;
+		struct camera_key key = {
+			.origin = gb_vec3(c*o.x - s*o.y, s*o.x + c*o.y, o.z),
+			.fov = vw->d3.fov,
+			.pitch = vw->d3.pitch,
+			.yaw = vw->d3.yaw + a,
+		};
+		arrput(vw->camera_key_arr, key);
+	}
+}
+
+static void view33(struct view_window* vw, gbVec3* out_view_forward, gbVec3* out_view_right, gbVec3* out_view_up)
+{
+	gbVec3 o = vw->d3.origin;
+	const float pitch = vw->d3.pitch;
+	const float yaw = vw->d3.yaw;
+	const float cos_pitch = cosf(pitch);
+	const float sin_pitch = sinf(pitch);
+	const float cos_yaw = cosf(yaw);
+	const float sin_yaw = sinf(yaw);
+
+	if (out_view_forward != NULL) {
+		*out_view_forward = gb_vec3(
+			cos_pitch * cos_yaw,
+			cos_pitch * sin_yaw,
+			sin_pitch);
+	}
+
+	if (out_view_right != NULL) {
+		*out_view_right = gb_vec3(
+			-sin_yaw,
+			 cos_yaw,
+			 0.0f);
+	}
+
+	if (out_view_up != NULL) {
+		*out_view_up = gb_vec3(
+			-sin_pitch * cos_yaw,
+			-sin_pitch * sin_yaw,
+			cos_pitch);
+	}
+}
+
+static void window_view(struct view_window* vw)
+{
+	struct view* view = get_view_window_view(vw);
 	ImGuiIO& io = ImGui::GetIO();
 	bool show = true;
 	if (ImGui::Begin(vw->window_title, &show)) {
@@ -674,7 +2399,138 @@ static void window_view(struct view_window* vw)
 
 		ImGui::SameLine();
 		if (ImGui::Button("Clone")) {
-			// TODO new window, same view
+			// deferred to iced_gui(); opening a window here could move
+			// view_window_arr under our feet
+			vw->do_clone = true;
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Render...")) {
+			snprintf(g.offline.path, sizeof g.offline.path, "%s.png", view->name);
+			ImGui::OpenPopup("render");
+		}
+		if (ImGui::BeginPopup("render")) {
+			ImGui::InputInt2("Size", g.offline.size);
+			ImGui::InputInt("Tile", &g.offline.tile_size, 64);
+			int aa_index = g.offline.aa - 1;
+			if (ImGui::Combo("AA", &aa_index, "Off" "\x0" "2x2" "\x0" "3x3" "\x0" "4x4" "\x0\x0")) {
+				g.offline.aa = aa_index + 1;
+			}
+			ImGui::InputText("Path", g.offline.path, sizeof g.offline.path);
+			if (ImGui::Button("Render")) {
+				vw->do_render_offline = true;
+				ImGui::CloseCurrentPopup();
+			}
+			ImGui::EndPopup();
+		}
+
+		if (dim == 3) {
+			ImGui::SameLine();
+			if (ImGui::Button("Path...")) {
+				snprintf(g.sequence.path, sizeof g.sequence.path, "%s_%%05d.png", view->name);
+				ImGui::OpenPopup("path");
+			}
+			if (ImGui::BeginPopup("path")) {
+				const int n_keys = arrlen(vw->camera_key_arr);
+				ImGui::Text("%d keyframe(s)", n_keys);
+				if (ImGui::Button("Add key")) {
+					struct camera_key key = {
+						.origin = vw->d3.origin,
+						.fov = vw->d3.fov,
+						.pitch = vw->d3.pitch,
+						.yaw = vw->d3.yaw,
+					};
+					arrput(vw->camera_key_arr, key);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Turntable")) {
+					camera_path_turntable(vw);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Clear")) {
+					arrsetlen(vw->camera_key_arr, 0);
+				}
+				ImGui::InputInt2("Size", g.sequence.size);
+				ImGui::InputInt("Frames", &g.sequence.n_frames);
+				ImGui::InputText("Path", g.sequence.path, sizeof g.sequence.path);
+				if (n_keys > 0 && ImGui::Button("Render sequence")) {
+					vw->do_render_sequence = true;
+					ImGui::CloseCurrentPopup();
+				}
+				if (g.sequence.fps > 0) {
+					ImGui::Text("last sequence: %.1f fps", g.sequence.fps);
+				}
+				ImGui::EndPopup();
+			}
+
+			ImGui::SameLine();
+			if (ImGui::Button("Light...")) {
+				ImGui::OpenPopup("light");
+			}
+			if (ImGui::BeginPopup("light")) {
+				struct lighting* li = &vw->lighting;
+				for (int i = 0; i < MAX_LIGHTS; i++) {
+					struct light* l = &li->lights[i];
+					ImGui::PushID(i);
+					char label[32];
+					snprintf(label, sizeof label, "Light %d", i);
+					ImGui::Checkbox(label, &l->enabled);
+					if (l->enabled) {
+						ImGui::SameLine();
+						ImGui::Checkbox("Follow camera", &l->follow_camera);
+						ImGui::DragFloat3("Position", l->position.e, 0.1f);
+						ImGui::DragFloat3("Color", l->color.e, 0.1f, 0.0f, 1000.0f);
+					}
+					ImGui::PopID();
+				}
+				ImGui::Separator();
+				ImGui::SliderFloat("Ambient", &li->ambient, 0.0f, 1.0f);
+				ImGui::SliderInt("Shadow steps", &li->shadow_steps, 0, 256);
+				ImGui::SliderFloat("Penumbra", &li->penumbra, 1.0f, 128.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+				ImGui::SliderInt("AO taps", &li->ao_taps, 0, 16);
+				ImGui::SliderFloat("AO step", &li->ao_step, 0.01f, 1.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+				ImGui::Separator();
+				ImGui::Combo("Shading", &li->shading, "Lit" "\x0" "Normals" "\x0" "Distance" "\x0" "Cost: steps" "\x0" "Cost: map calls" "\x0" "Cost: shadow steps" "\x0\x0");
+				if (li->shading >= SHADING_STEPS) {
+					ImGui::SliderInt("Heat max", &li->heat_max, 1, COST_BINS, "%d", ImGuiSliderFlags_Logarithmic);
+				} else {
+					ImGui::SliderFloat("Exposure", &li->exposure, 0.1f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+					ImGui::Checkbox("Tone map", &li->tonemap);
+				}
+				if (ImGui::Button("Reset")) {
+					lighting_reset(li);
+				}
+				ImGui::EndPopup();
+			}
+
+			ImGui::SameLine();
+			if (ImGui::Button("March...")) {
+				ImGui::OpenPopup("march");
+			}
+			if (ImGui::BeginPopup("march")) {
+				struct march* m = &vw->march;
+				ImGui::Combo("Kernel", &m->kernel, "Sphere tracing" "\x0" "Relaxed" "\x0\x0");
+				if (m->kernel == MARCH_RELAXED) {
+					ImGui::SliderFloat("Relaxation", &m->relaxation, 1.0f, 2.0f);
+				}
+				ImGui::Checkbox("Pixel footprint epsilon", &m->adaptive_epsilon);
+				ImGui::SliderFloat("Far", &m->far, 1.0f, 1000.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+				ImGui::SliderInt("Max steps", &m->max_steps, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+				if (ImGui::Button("Reset")) {
+					march_reset(m);
+				}
+				ImGui::EndPopup();
+			}
+
+			const int rri = vw->render_result;
+			if (vw->lighting.shading >= SHADING_STEPS && rri >= 0 && render_result_arr[rri].has_cost) {
+				static const char* names[COST_METRICS] = { "steps", "map calls", "shadow steps" };
+				for (int i = 0; i < COST_METRICS; i++) {
+					const struct cost_stats* st = &render_result_arr[rri].cost[i];
+					ImGui::Text("%s: mean %.1f, p99 %d, max %d", names[i], st->mean, st->p99, st->max);
+					if (i+1 < COST_METRICS) ImGui::SameLine(0, 20);
+				}
+			}
 		}
 
 		const ImVec2 p0 = ImGui::GetCursorScreenPos();
@@ -690,7 +2546,39 @@ static void window_view(struct view_window* vw)
 				ImGui::SameLine();
 				const float x = vw->d2.origin.x + mx * vw->d2.scale;
 				const float y = vw->d2.origin.y + my * vw->d2.scale;
-				ImGui::Text("[%.3f,%.3f]", x, y);
+				if (view->has_ir) {
+					const float p[] = {x, y, 0.0f};
+					int material;
+					const float d = icir_eval(&view->ir, p, &material);
+					ImGui::Text("[%.3f,%.3f] d=%.3f m=%d", x, y, d, material);
+				} else {
+					ImGui::Text("[%.3f,%.3f]", x, y);
+				}
+			}
+		} else if (dim == 3) {
+			const bool inside = fabsf(mx) < canvas_size.x*0.5f && fabsf(my) < canvas_size.y*0.5f;
+			if (mousepos_avail && inside && view->has_ir && canvas_size.x > 0 && !vw->d3.is_flying) {
+				// CPU pick of what's under the mouse, through the same
+				// camera as draw_view_region()
+				gbVec3 dir, u, v, t;
+				view33(vw, &dir, &u, &v);
+				const float su = tanf(vw->d3.fov*0.5f);
+				gb_vec3_mul(&t, u, su * (2.0f*mx / canvas_size.x));
+				gb_vec3_add(&dir, dir, t);
+				gb_vec3_mul(&t, v, su * (2.0f*my / canvas_size.x));
+				gb_vec3_add(&dir, dir, t);
+				float hit_t;
+				int material;
+				ImGui::SameLine();
+				if (icir_march(&view->ir, vw->d3.origin.e, dir.e, 100.0f, &hit_t, &material)) {
+					gbVec3 hit;
+					gb_vec3_norm0(&dir, dir);
+					gb_vec3_mul(&t, dir, hit_t);
+					gb_vec3_add(&hit, vw->d3.origin, t);
+					ImGui::Text("[%.3f,%.3f,%.3f] t=%.3f m=%d", hit.x, hit.y, hit.z, hit_t, material);
+				} else {
+					ImGui::Text("-");
+				}
 			}
 		}
 
@@ -720,7 +2608,6 @@ static void window_view(struct view_window* vw)
 						const float s = vw->d2.scale;
 						vw->d2.origin.x -= d.x*s;
 						vw->d2.origin.y -= d.y*s;
-						vw->serial = next_serial();
 					}
 
 					if (ImGui::IsMouseReleased(1)) {
@@ -734,13 +2621,19 @@ static void window_view(struct view_window* vw)
 					const float sc1 = vw->d2.scale;
 					vw->d2.origin.x += (mx * sc0) - (mx * sc1);
 					vw->d2.origin.y += (my * sc0) - (my * sc1);
-					vw->serial = next_serial();
 				}
 			}
 
-			if (vw->gl_initialized && vw->texture) {
+			const int fb_width = (int)canvas_size.x / px;
+			const int fb_height = (int)canvas_size.y / px;
+			if (dim == 2) {
+				draw_view_tiles(view, vw, ImGui::GetWindowDrawList(), p0, canvas_size);
+			} else if (fb_width > 0 && fb_height > 0) {
+				acquire_render_result(vw, view, fb_width, fb_height);
+				struct render_result* rr = &render_result_arr[vw->render_result];
 				ImDrawList* draw_list = ImGui::GetWindowDrawList();
-				draw_list->AddImage((void*)(intptr_t)vw->texture, p0, p1);
+				const GLuint texture = render_target_arr[rr->target].texture;
+				draw_list->AddImage((void*)(intptr_t)texture, p0, p1, vw->uv0, vw->uv1);
 			}
 		}
 	}
@@ -750,13 +2643,8 @@ static void window_view(struct view_window* vw)
 
 static void view_window_free(struct view_window* vw)
 {
-	if (vw->gl_initialized) {
-		glDeleteTextures(1, &vw->texture);
-		glDeleteFramebuffers(1, &vw->framebuffer);
-		vw->texture = 0;
-		vw->framebuffer = 0;
-		vw->gl_initialized = false;
-	}
+	arrfree(vw->camera_key_arr);
+	// render results are left for iced_render() to recycle or release
 	free((void*)vw->view_name);
 	free((void*)vw->window_title);
 }
@@ -764,10 +2652,32 @@ static void view_window_free(struct view_window* vw)
 static void view_free(struct view* v)
 {
 	glDeleteProgram(v->prg0);
+	if (v->params_fence != NULL) glDeleteSync(v->params_fence);
+	glDeleteBuffers(1, &v->params_buffer);
+	glDeleteBuffers(1, &v->ir_buffer);
+	glDeleteBuffers(1, &v->palette_buffer);
+	if (v->has_ir) icir_close(&v->ir);
+	free(v->ir_data);
 	free((void*)v->name);
 }
 
-static void open_view_window(struct view* view)
+static void view_window_reset_camera(struct view_window* vw, int dim)
+{
+	switch (dim) {
+	case 2:
+		memset(&vw->d2, 0, sizeof vw->d2);
+		vw->d2.scale = 0.03f;
+		break;
+	case 3:
+		memset(&vw->d3, 0, sizeof vw->d3);
+		vw->d3.fov = gb_to_radians(105);
+		vw->d3.origin = gb_vec3(-10,0,0);
+		break;
+	default: assert(!"bad dim");
+	}
+}
+
+static struct view_window* open_view_window(struct view* view)
 {
 	int sequence = 0;
 	{
@@ -780,51 +2690,488 @@ static void open_view_window(struct view* view)
 		}
 	}
 
-	char wt[1<<10];
-	snprintf(wt, sizeof wt, "[%dD] %s /%d", view->dim, view->name, sequence);
-	struct view_window vw = {
-		.view_name = cstrdup(view->name),
-		.window_title = cstrdup(wt),
-		.sequence = sequence,
-	};
-	switch (view->dim) {
-	case 2:
-		memset(&vw.d2, 0, sizeof vw.d2);
-		vw.d2.scale = 0.03f;
-		break;
-	case 3:
-		memset(&vw.d3, 0, sizeof vw.d3);
-		vw.d3.fov = gb_to_radians(105);
-		vw.d3.origin = gb_vec3(-10,0,0);
-		break;
-	default: assert(!"bad dim");
+	char wt[1<<10];
+	snprintf(wt, sizeof wt, "[%dD] %s /%d", view->dim, view->name, sequence);
+	struct view_window vw = {
+		.view_name = cstrdup(view->name),
+		.window_title = cstrdup(wt),
+		.sequence = sequence,
+		.render_result = -1,
+	};
+	view_window_reset_camera(&vw, view->dim);
+	lighting_reset(&vw.lighting);
+	march_reset(&vw.march);
+	arrput(view_window_arr, vw);
+	return &view_window_arr[arrlen(view_window_arr)-1];
+}
+
+static void clone_view_window(struct view_window* vw)
+{
+	struct view* view = get_view_window_view(vw);
+	const int src = vw - view_window_arr;
+	struct view_window* clone = open_view_window(view);
+	vw = &view_window_arr[src]; // open_view_window() may have moved it
+	clone->pixel_size = vw->pixel_size;
+	clone->d2 = vw->d2;
+	clone->d3 = vw->d3;
+	clone->d2.is_panning = false;
+	clone->d3.is_flying = false;
+}
+
+static void open_view(const char* name, int dim)
+{
+	const int n = arrlen(view_arr);
+	for (int i = 0; i < n; i++) {
+		struct view* view = &view_arr[i];
+		if (strcmp(view->name, name) == 0) {
+			open_view_window(view);
+			return;
+		}
+	}
+
+	struct view view = {0};
+	view.name = cstrdup(name);
+	view.dim = dim;
+	reload_view(&view);
+	if (!g.has_error) {
+		arrput(view_arr, view);
+		open_view_window(&view);
+	}
+}
+
+static const ImVec4 errtxt = ImVec4(1.0f, 0.7f, 0.7f, 1.0f);
+
+static void draw_view(struct view* view, struct view_window* vw, int fb_width, int fb_height);
+
+// thumbnail files are THUMB_MAGIC, width and height as int32, then the RGB
+// rows bottom-up. bump THUMB_VERSION when thumbnails would come out
+// differently for the same view, to orphan the old ones
+#define THUMB_MAGIC "ICTH"
+#define THUMB_VERSION (1)
+
+static void thumb_path(char* path, size_t size, size_t hash)
+{
+	snprintf(path, size, GALLERY_CACHE_DIR "/%016zx.thumb", hash);
+}
+
+static void gallery_index_path(char* path, size_t size)
+{
+	snprintf(path, size, GALLERY_CACHE_DIR "/%s.index", g.world_module_name);
+}
+
+static size_t thumb_hash(const struct view_gen* gen)
+{
+	const size_t h = stbds_hash_bytes((void*)gen->source, strlen(gen->source), THUMB_VERSION);
+	return gen->ir_size > 0 ? stbds_hash_bytes((void*)gen->ir_data, gen->ir_size, h) : h;
+}
+
+static struct thumb* thumb_find(const char* name)
+{
+	for (int i = 0; i < arrlen(thumb_arr); i++) {
+		if (strcmp(thumb_arr[i].name, name) == 0) return &thumb_arr[i];
+	}
+	return NULL;
+}
+
+static GLuint thumb_texture(const uint8_t* pixels)
+{
+	GLuint texture;
+	glGenTextures(1, &texture); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, texture); CHKGL;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); CHKGL;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); CHKGL;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB, THUMB_WIDTH, THUMB_HEIGHT, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, pixels); CHKGL;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	return texture;
+}
+
+// loads the thumbnail th->hash names; false if there's none on disk
+static bool thumb_load(struct thumb* th)
+{
+	char path[1<<10];
+	thumb_path(path, sizeof path, th->hash);
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return false;
+	static uint8_t pixels[THUMB_WIDTH*THUMB_HEIGHT*3];
+	char magic[4];
+	int32_t size[2];
+	const bool ok =
+		fread(magic, sizeof magic, 1, f) == 1 && memcmp(magic, THUMB_MAGIC, sizeof magic) == 0 &&
+		fread(size, sizeof size, 1, f) == 1 && size[0] == THUMB_WIDTH && size[1] == THUMB_HEIGHT &&
+		fread(pixels, sizeof pixels, 1, f) == 1;
+	fclose(f);
+	if (!ok) return false;
+	if (th->texture != 0) {
+		glDeleteTextures(1, &th->texture); CHKGL;
+	}
+	th->texture = thumb_texture(pixels);
+	return true;
+}
+
+static void thumb_save(size_t hash, const uint8_t* pixels)
+{
+	mkdir(GALLERY_CACHE_DIR, 0755);
+	char path[1<<10];
+	thumb_path(path, sizeof path, hash);
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "gallery: %s: cannot open for writing\n", path);
+		return;
+	}
+	const int32_t size[2] = { THUMB_WIDTH, THUMB_HEIGHT };
+	fwrite(THUMB_MAGIC, 4, 1, f);
+	fwrite(size, sizeof size, 1, f);
+	fwrite(pixels, THUMB_WIDTH*THUMB_HEIGHT*3, 1, f);
+	fclose(f);
+}
+
+// hashes of the last thumbnails, for the entries that have none yet
+static void gallery_index_load(void)
+{
+	char path[1<<10];
+	gallery_index_path(path, sizeof path);
+	FILE* f = fopen(path, "r");
+	if (f == NULL) return;
+	char line[1<<10];
+	while (fgets(line, sizeof line, f) != NULL) {
+		size_t hash;
+		char name[1<<9];
+		if (sscanf(line, "%zx %511s", &hash, name) != 2) continue;
+		struct thumb* th = thumb_find(name);
+		if (th != NULL && th->texture == 0 && th->hash == 0) th->hash = hash;
+	}
+	fclose(f);
+}
+
+static void gallery_index_save(void)
+{
+	mkdir(GALLERY_CACHE_DIR, 0755);
+	char path[1<<10];
+	gallery_index_path(path, sizeof path);
+	FILE* f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "gallery: %s: cannot open for writing\n", path);
+		return;
+	}
+	for (int i = 0; i < arrlen(thumb_arr); i++) {
+		const struct thumb* th = &thumb_arr[i];
+		if (th->hash != 0) fprintf(f, "%016zx %s\n", th->hash, th->name);
+	}
+	fclose(f);
+}
+
+// renders the view into the thumbnail with a view window's default camera
+// and lighting, and saves it as hash
+static void thumb_render(struct thumb* th, struct view* view, size_t hash)
+{
+	if (g.gallery.framebuffer == 0) {
+		glGenFramebuffers(1, &g.gallery.framebuffer); CHKGL;
+	}
+	if (th->texture == 0) th->texture = thumb_texture(NULL);
+	glBindFramebuffer(GL_FRAMEBUFFER, g.gallery.framebuffer); CHKGL;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, th->texture, /*level=*/0); CHKGL;
+	glViewport(0, 0, THUMB_WIDTH, THUMB_HEIGHT);
+
+	struct view_window vw = {0};
+	view_window_reset_camera(&vw, view->dim);
+	lighting_reset(&vw.lighting);
+	march_reset(&vw.march);
+	if (view->dim == 2) vw.d2.scale *= 640.0f / (float)THUMB_WIDTH; // frames like a 640 pixel wide window
+	draw_view(view, &vw, THUMB_WIDTH, THUMB_HEIGHT);
+
+	static uint8_t pixels[THUMB_WIDTH*THUMB_HEIGHT*3];
+	glPixelStorei(GL_PACK_ALIGNMENT, 1); CHKGL;
+	glReadPixels(0, 0, THUMB_WIDTH, THUMB_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels); CHKGL;
+	glPixelStorei(GL_PACK_ALIGNMENT, 4); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+	thumb_save(hash, pixels);
+}
+
+// codegen result for a gallery entry: nothing to do if its thumbnail is of
+// the same source and IR, otherwise it's rendered again, by the open view if
+// that has both (a bulk-params view keeps its program across params changes,
+// so the source alone doesn't say), or else by a program compiled into view
+// for the purpose
+static void thumb_on_gen(struct view* view, const struct view_gen* gen, double duration_codegen)
+{
+	struct thumb* th = thumb_find(view->name);
+	if (th == NULL) return;
+	const size_t hash = thumb_hash(gen);
+	if (th->texture != 0 && th->hash == hash) {
+		th->state = THUMB_CURRENT;
+		return;
+	}
+
+	const size_t source_hash = stbds_hash_bytes((void*)gen->source, strlen(gen->source), 0);
+	struct view* v = NULL;
+	for (int i = 0; i < arrlen(view_arr); i++) {
+		struct view* open = &view_arr[i];
+		if (strcmp(open->name, view->name) != 0 || open->prg0 == 0) continue;
+		if (open->source_hash != source_hash || open->ir_size != gen->ir_size) continue;
+		if (gen->ir_size > 0 && memcmp(open->ir_data, gen->ir_data, gen->ir_size) != 0) continue;
+		v = open;
+	}
+	if (v == NULL) {
+		// a view that fails to compile here isn't the world's error
+		static char error_message[sizeof g.error_message];
+		const bool has_error = g.has_error;
+		memcpy(error_message, g.error_message, sizeof error_message);
+		const double duration_compile = g.duration_compile;
+		update_view(view, gen, duration_codegen);
+		g.has_error = has_error;
+		memcpy(g.error_message, error_message, sizeof error_message);
+		g.duration_compile = duration_compile;
+		if (view->prg0 == 0) {
+			fprintf(stderr, "gallery: view `%s` failed to compile\n", view->name);
+			th->state = THUMB_FAILED;
+			return;
+		}
+		v = view;
+	}
+	thumb_render(th, v, hash);
+	th->hash = hash;
+	th->state = THUMB_CURRENT;
+	g.gallery.index_dirty = true;
+}
+
+static void thumb_on_reply(struct thumb* th)
+{
+	struct codegen_job* job = th->reply;
+	th->reply = NULL;
+	if (job->ok) {
+		struct view view = {0};
+		view.name = cstrdup(th->name);
+		view.dim = th->dim;
+		const struct view_gen gen = view_gen_from_reply(job);
+		thumb_on_gen(&view, &gen, job->duration);
+		view_free(&view);
+	} else {
+		fprintf(stderr, "gallery: view `%s` failed:\n%s", th->name, job->payload);
+		th->state = THUMB_FAILED;
+	}
+	free(job->payload);
+	free(job);
+}
+
+static void gallery_worker_request(struct thumb* th)
+{
+	struct codegen_worker* w = &g.gallery.worker;
+	if (w->pid <= 0) codegen_worker_spawn(w); // imports the world with the first request
+	snprintf(g.gallery.request_name, sizeof g.gallery.request_name, "%s", th->name);
+	char line[sizeof g.gallery.request_name + 8];
+	const int n = snprintf(line, sizeof line, "view %s\n", th->name);
+	if (write(w->request_fd, line, n) != n) {
+		// dead worker; gallery_worker_poll() sees EOF and fails the thumbnail
+	}
+	w->job = 0;
+	w->t0 = timer_begin();
+	arrsetlen(w->reply_arr, 0);
+	th->state = THUMB_REQUESTED;
+}
+
+// the gallery's codegen runs on a worker of its own, outside the pool, so it
+// never holds up codegen_run() and no frame waits for it: a request is sent,
+// and a later frame picks up the reply. a worker that exits or times out is
+// respawned with the next request
+static void gallery_worker_poll(void)
+{
+	struct codegen_worker* w = &g.gallery.worker;
+	if (w->pid <= 0 || w->job < 0) return;
+	struct thumb* th = thumb_find(g.gallery.request_name);
+	char buf[1<<16];
+	ssize_t n;
+	while ((n = read(w->reply_fd, buf, sizeof buf)) > 0) {
+		memcpy(arraddnptr(w->reply_arr, n), buf, n);
+	}
+	struct codegen_job* job = (struct codegen_job*)calloc(1, sizeof *job);
+	if (codegen_worker_parse_reply(w, &job->ok, &job->payload, &job->payload_size)) {
+		job->duration = timer_end(w->t0);
+		w->job = -1;
+		if (th != NULL && th->state == THUMB_REQUESTED) {
+			th->reply = job;
+			th->state = THUMB_READY;
+		} else {
+			free(job->payload);
+			free(job);
+		}
+		return;
+	}
+	free(job);
+	const char* failure =
+		n == 0 ? "codegen worker exited" :
+		timer_end(w->t0) > CODEGEN_TIMEOUT ? "codegen worker timed out" :
+		NULL;
+	if (failure == NULL) return;
+	fprintf(stderr, "gallery: %s on view `%s`\n", failure, g.gallery.request_name);
+	if (th != NULL && th->state == THUMB_REQUESTED) th->state = THUMB_FAILED;
+	codegen_worker_kill(w);
+}
+
+// rebuilds thumb_arr from viewlist() after each load of the world, keeping
+// the thumbnails of the views that are still there; all of them are checked
+// against their view again
+static void gallery_sync(void)
+{
+	if (g.gallery.world_serial == g.world_serial) return;
+	g.gallery.world_serial = g.world_serial;
+	codegen_worker_kill(&g.gallery.worker); // it has the old world
+	if (!g.python_initialized || g.python_world_module == NULL) return;
+
+	struct thumb* old_arr = thumb_arr;
+	thumb_arr = NULL;
+	PyObject* pfn = PyObject_GetAttrString(g.python_world_module, "viewlist");
+	PyObject* pr = pfn != NULL ? PyObject_CallObject(pfn, NULL) : NULL;
+	PyObject* it = pr != NULL ? PyObject_GetIter(pr) : NULL;
+	if (it != NULL) {
+		PyObject* item;
+		while ((item = PyIter_Next(it)) != NULL) {
+			PyObject* pname = PyObject_GetAttrString(item, "name");
+			PyObject* pdim = PyObject_GetAttrString(item, "dim");
+			if (pname != NULL && pdim != NULL) {
+				struct thumb th = {0};
+				th.name = cstrdup(PyUnicode_AsUTF8(pname));
+				th.dim = PyLong_AsLong(pdim);
+				for (int i = 0; i < arrlen(old_arr); i++) {
+					struct thumb* old = &old_arr[i];
+					if (old->dim != th.dim || strcmp(old->name, th.name) != 0) continue;
+					th.hash = old->hash;
+					th.texture = old->texture;
+					old->texture = 0;
+				}
+				arrput(thumb_arr, th);
+			}
+			Py_XDECREF(pdim);
+			Py_XDECREF(pname);
+			Py_DECREF(item);
+		}
+		Py_DECREF(it);
+	}
+	Py_XDECREF(pr);
+	Py_XDECREF(pfn);
+	PyErr_Clear();
+
+	for (int i = 0; i < arrlen(old_arr); i++) {
+		free(old_arr[i].name);
+		if (old_arr[i].reply != NULL) {
+			free(old_arr[i].reply->payload);
+			free(old_arr[i].reply);
+		}
+		if (old_arr[i].texture != 0) {
+			glDeleteTextures(1, &old_arr[i].texture); CHKGL;
+		}
+	}
+	arrfree(old_arr);
+	gallery_index_load();
+}
+
+// the gallery's share of the frame: entries in sight get their thumbnail
+// from disk, then are checked against their view and rendered again where it
+// changed, while GALLERY_BUDGET lasts. a reply's compile and render is only
+// started if the last one would still have fit; one that can't fit even on
+// its own still gets a frame to itself, as a compile can't be cut short
+static void gallery_update(void)
+{
+	if (!g.gallery.show || !g.python_initialized || g.python_world_module == NULL) return;
+	struct timespec t0 = timer_begin();
+
+	for (int i = 0; i < arrlen(thumb_arr) && timer_end(t0) < GALLERY_BUDGET; i++) {
+		struct thumb* th = &thumb_arr[i];
+		if (!th->visible || th->texture != 0 || th->hash == 0) continue;
+		if (!thumb_load(th)) th->hash = 0;
+	}
+
+	// the next request goes out before the replies are compiled, so the
+	// worker's codegen overlaps with that
+	const bool has_workers = arrlen(codegen_worker_arr) > 0;
+	if (has_workers) {
+		gallery_worker_poll();
+		struct codegen_worker* w = &g.gallery.worker;
+		for (int i = 0; i < arrlen(thumb_arr) && (w->pid <= 0 || w->job < 0); i++) {
+			struct thumb* th = &thumb_arr[i];
+			if (th->visible && th->state == THUMB_PENDING) gallery_worker_request(th);
+		}
+	}
+
+	bool first = true;
+	for (int i = 0; i < arrlen(thumb_arr); i++) {
+		struct thumb* th = &thumb_arr[i];
+		const bool ready = th->state == THUMB_READY || (!has_workers && th->visible && th->state == THUMB_PENDING);
+		if (!ready) continue;
+		const double elapsed = timer_end(t0);
+		if (elapsed >= GALLERY_BUDGET || (!first && elapsed + g.gallery.reply_duration > GALLERY_BUDGET)) break;
+		first = false;
+		struct timespec t1 = timer_begin();
+		if (th->state == THUMB_READY) {
+			thumb_on_reply(th);
+		} else {
+			// no workers: the constructor runs in-process, like all codegen then
+			struct view view = {0};
+			view.name = cstrdup(th->name);
+			view.dim = th->dim;
+			if (!codegen_view_inprocess(&view, thumb_on_gen)) {
+				fprintf(stderr, "gallery: view `%s` failed in its constructor\n", th->name);
+				PyErr_Clear();
+				th->state = THUMB_FAILED;
+			}
+			view_free(&view);
+		}
+		g.gallery.reply_duration = timer_end(t1);
+	}
+
+	if (g.gallery.index_dirty) {
+		g.gallery.index_dirty = false;
+		gallery_index_save();
 	}
-	arrput(view_window_arr, vw);
 }
 
-static void open_view(const char* name, int dim)
+// thumbnails of every view in viewlist(); clicking one opens the view
+static void window_gallery(void)
 {
-	const int n = arrlen(view_arr);
-	for (int i = 0; i < n; i++) {
-		struct view* view = &view_arr[i];
-		if (strcmp(view->name, name) == 0) {
-			open_view_window(view);
-			return;
+	for (int i = 0; i < arrlen(thumb_arr); i++) thumb_arr[i].visible = false;
+	if (!g.gallery.show) return;
+	gallery_sync();
+	if (ImGui::Begin("Gallery", &g.gallery.show)) {
+		const ImGuiStyle& style = ImGui::GetStyle();
+		const ImVec2 image_size = ImVec2(THUMB_WIDTH, THUMB_HEIGHT);
+		const ImVec2 button_size = ImVec2(image_size.x + 2*style.FramePadding.x, image_size.y + 2*style.FramePadding.y);
+		const ImVec2 cell_size = ImVec2(button_size.x, button_size.y + style.ItemSpacing.y + ImGui::GetTextLineHeight());
+		const int columns = gb_max(1, (int)((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / (cell_size.x + style.ItemSpacing.x)));
+		for (int i = 0; i < arrlen(thumb_arr); i++) {
+			struct thumb* th = &thumb_arr[i];
+			if (i % columns != 0) ImGui::SameLine();
+			ImGui::PushID(i);
+			ImGui::BeginGroup();
+			th->visible = ImGui::IsRectVisible(cell_size);
+			bool clicked;
+			if (th->texture != 0) {
+				clicked = ImGui::ImageButton("thumb", (ImTextureID)(intptr_t)th->texture, image_size);
+			} else {
+				clicked = ImGui::Button(th->state == THUMB_FAILED ? "failed" : "...", button_size);
+			}
+			if (clicked) open_view(th->name, th->dim);
+
+			// the name, shortened to the thumbnail's width
+			char label[1<<9];
+			int n = snprintf(label, sizeof label, "[%dD] %s", th->dim, th->name);
+			n = gb_min(n, (int)sizeof label - 1);
+			while (n > 3 && ImGui::CalcTextSize(label).x > button_size.x) {
+				n--;
+				memcpy(&label[n-3], "...", 4);
+			}
+			if (th->state == THUMB_FAILED) {
+				ImGui::TextColored(errtxt, "%s", label);
+			} else {
+				ImGui::TextUnformatted(label);
+			}
+			ImGui::EndGroup();
+			ImGui::PopID();
 		}
 	}
-
-	struct view view = {0};
-	view.name = cstrdup(name);
-	view.dim = dim;
-	reload_view(&view);
-	if (!g.has_error) {
-		arrput(view_arr, view);
-		open_view_window(&view);
-	}
+	ImGui::End();
 }
 
-static const ImVec4 errtxt = ImVec4(1.0f, 0.7f, 0.7f, 1.0f);
-
 static void window_main(void)
 {
 	static bool show_main = true;
@@ -858,11 +3205,26 @@ static void window_main(void)
 				}
 			}
 
+			int n_targets = 0;
+			size_t target_bytes = 0;
+			for (int i = 0; i < arrlen(render_target_arr); i++) {
+				struct render_target* rt = &render_target_arr[i];
+				if (rt->texture == 0) continue;
+				n_targets++;
+				target_bytes += render_target_bytes(rt);
+			}
+
 			ImGui::SeparatorText("Status");
-			ImGui::Text("Load: %fs\nExec: %fs\nGC: %s",
+			ImGui::Text("Load: %fs\nExec: %fs\nCompile: %fs\nView updates: %d kept, %d uploaded, %d compiled\nGC: %s\nRender targets: %d (%.1fMB)",
 				g.duration_load,
 				g.duration_exec,
-				gc);
+				g.duration_compile,
+				g.n_updates_skipped,
+				g.n_updates_uploaded,
+				g.n_updates_compiled,
+				gc,
+				n_targets,
+				(double)target_bytes / (double)(1<<20));
 
 			if (ImGui::Button("Soft Reload")) {
 				reload_script();
@@ -872,8 +3234,11 @@ static void window_main(void)
 				g.python_do_reinitialize = true;
 				reload_script();
 			}
+			ImGui::SameLine();
+			ImGui::Checkbox("Frame pacing", &g.show_frame_pacing);
 
 			ImGui::SeparatorText("Views");
+			ImGui::Checkbox("Gallery", &g.gallery.show);
 			if (!g.python_initialized) {
 				ImGui::TextColored(errtxt, "python not initialized");
 			} else {
@@ -922,36 +3287,100 @@ static void window_main(void)
 	}
 }
 
-static void view33(struct view_window* vw, gbVec3* out_view_forward, gbVec3* out_view_right, gbVec3* out_view_up)
+static void fly_turn(struct view_window* vw, float dyaw, float dpitch)
 {
-	gbVec3 o = vw->d3.origin;
-	const float pitch = vw->d3.pitch;
-	const float yaw = vw->d3.yaw;
-	const float cos_pitch = cosf(pitch);
-	const float sin_pitch = sinf(pitch);
-	const float cos_yaw = cosf(yaw);
-	const float sin_yaw = sinf(yaw);
+	const float sens = 0.005f;
+	vw->d3.yaw += dyaw * sens;
+	vw->d3.pitch += dpitch * sens;
+}
 
-	if (out_view_forward != NULL) {
-		*out_view_forward = gb_vec3(
-			cos_pitch * cos_yaw,
-			cos_pitch * sin_yaw,
-			sin_pitch);
-	}
+// the render result is retargeted to the new camera rather than a new one
+// acquired, since the draw list already names its texture. one that another
+// window shows too stays as it is; the turn shows next frame
+void iced_fly_late(float dyaw, float dpitch)
+{
+	struct view_window* vw = g.flying_view_window;
+	if (vw == NULL || g.flystate == 0 || (dyaw == 0 && dpitch == 0)) return;
+	fly_turn(vw, dyaw, dpitch);
+	const int rri = vw->render_result;
+	if (rri < 0 || render_result_shared(rri, vw)) return;
+	struct render_result* rr = &render_result_arr[rri];
+	if (!rr->in_use || rr->last_used_frame < g.frame) return;
+	rr->cam.pitch = vw->d3.pitch;
+	rr->cam.yaw = vw->d3.yaw;
+	rr->owner = vw - view_window_arr;
+	rr->dirty = true;
+}
 
-	if (out_view_right != NULL) {
-		*out_view_right = gb_vec3(
-			-sin_yaw,
-			 cos_yaw,
-			 0.0f);
-	}
+static int float_compar(const void* a, const void* b)
+{
+	const float fa = *(const float*)a;
+	const float fb = *(const float*)b;
+	return fa < fb ? -1 : fa > fb ? 1 : 0;
+}
 
-	if (out_view_up != NULL) {
-		*out_view_up = gb_vec3(
-			-sin_pitch * cos_yaw,
-			-sin_pitch * sin_yaw,
-			cos_pitch);
+// frame intervals and motion-to-photon latency as the main loop measures them
+// (struct frame_pacing), and its latency settings
+static void window_frame_pacing(void)
+{
+	if (!g.show_frame_pacing) return;
+	if (ImGui::Begin("Frame pacing", &g.show_frame_pacing)) {
+		struct frame_pacing* fp = get_frame_pacing();
+		if (fp == NULL) {
+			ImGui::TextColored(errtxt, "not measured by this frontend");
+		} else {
+			ImGui::Checkbox("Late input sampling", &fp->late_input);
+			ImGui::SetItemTooltip("Fly mode mouse motion that arrives while the GUI is built\nstill turns the camera of the frame being rendered");
+			ImGui::BeginDisabled(!fp->has_adaptive_vsync);
+			ImGui::Checkbox("Adaptive vsync", &fp->adaptive_vsync);
+			ImGui::EndDisabled();
+			ImGui::SetItemTooltip(fp->has_adaptive_vsync ? "Swap late frames at once (and tear) rather than a refresh later" : "Not supported by the driver");
+			ImGui::SliderInt("Max queued frames", &fp->max_queued_frames, 0, 4, fp->max_queued_frames == 0 ? "no limit" : "%d");
+			ImGui::SetItemTooltip("Swaps the GPU may lag behind before the next frame waits for it");
+
+			// the rings in order, oldest first
+			const int n_frames = fp->n_frames;
+			const int frame_offset = n_frames < PACING_HISTORY ? 0 : fp->frame_cursor;
+			float frame_sum = 0.0f, frame_max = 0.0f;
+			for (int i = 0; i < n_frames; i++) {
+				frame_sum += fp->frame_ms[i];
+				frame_max = gb_max(frame_max, fp->frame_ms[i]);
+			}
+			char overlay[1<<8];
+			snprintf(overlay, sizeof overlay, "avg %.1fms, max %.1fms", n_frames > 0 ? frame_sum / (float)n_frames : 0.0f, frame_max);
+			ImGui::SeparatorText("Frame interval");
+			ImGui::PlotLines("##frame_ms", fp->frame_ms, n_frames, frame_offset, overlay, 0.0f, gb_max(frame_max, 1.0f), ImVec2(-1, 80));
+
+			ImGui::SeparatorText("Motion-to-photon");
+			static float sorted[PACING_HISTORY];
+			const int n_latencies = fp->n_latencies;
+			memcpy(sorted, fp->latency_ms, n_latencies * sizeof *sorted);
+			qsort(sorted, n_latencies, sizeof *sorted, float_compar);
+			if (n_latencies > 0) {
+				ImGui::Text("last %d frames with motion: p50 %.1fms, p95 %.1fms, max %.1fms",
+					n_latencies,
+					sorted[n_latencies/2],
+					sorted[(n_latencies*95)/100],
+					sorted[n_latencies-1]);
+			} else {
+				ImGui::Text("move the mouse");
+			}
+			float histogram[PACING_BINS];
+			int histogram_max = 0;
+			for (int i = 0; i < PACING_BINS; i++) {
+				histogram[i] = (float)fp->histogram[i];
+				histogram_max = gb_max(histogram_max, fp->histogram[i]);
+			}
+			snprintf(overlay, sizeof overlay, "0-%.0fms, %.0fms per bar", PACING_BINS * PACING_BIN_MS, PACING_BIN_MS);
+			ImGui::PlotHistogram("##latency", histogram, PACING_BINS, 0, overlay, 0.0f, (float)gb_max(histogram_max, 1), ImVec2(-1, 80));
+			if (ImGui::Button("Reset")) {
+				fp->n_frames = fp->frame_cursor = 0;
+				fp->n_latencies = fp->latency_cursor = 0;
+				memset(fp->histogram, 0, sizeof fp->histogram);
+			}
+		}
 	}
+	ImGui::End();
 }
 
 static void handle_flying(void)
@@ -973,8 +3402,6 @@ static void handle_flying(void)
 		g.flystate = 1;
 	}
 
-	bool changed = false;
-
 	#if 0
 	printf("pos %f %f %f\n",
 		vw->d3.origin.x,
@@ -986,15 +3413,8 @@ static void handle_flying(void)
 		vw->d3.origin = g.save_origin;
 		vw->d3.pitch = g.save_pitch;
 		vw->d3.yaw = g.save_yaw;
-		changed = true;
 	} else {
-		const float sens = 0.005f;
-		const float dyaw = fs->dyaw * sens;
-		if (dyaw != 0.0f) changed = true;
-		const float dpitch = fs->dpitch * sens;
-		if (dpitch != 0.0f) changed = true;
-		vw->d3.yaw += dyaw;
-		vw->d3.pitch += dpitch;
+		fly_turn(vw, fs->dyaw, fs->dpitch);
 
 		if (fs->dforward != 0 || fs->dright != 0) {
 			gbVec3 forward, right, up;
@@ -1007,23 +3427,21 @@ static void handle_flying(void)
 				gbVec3 v = forward;
 				gb_vec3_muleq(&v, step * (float)fs->dforward);
 				gb_vec3_add(&vw->d3.origin, vw->d3.origin, v);
-				changed = true;
 			}
 
 			if (fs->dright) {
 				gbVec3 v = right;
 				gb_vec3_muleq(&v, step * (float)fs->dright);
 				gb_vec3_add(&vw->d3.origin, vw->d3.origin, v);
-				changed = true;
 			}
 		}
 	}
-
-	if (changed) vw->serial = next_serial();
 }
 
 void iced_gui(void)
 {
+	g.frame++;
+	python_acquire();
 	handle_flying();
 
 	for (int i0 = 0; i0 < arrlen(view_window_arr); i0++) {
@@ -1058,11 +3476,29 @@ void iced_gui(void)
 	}
 	check_for_reload();
 	window_main();
+	window_gallery();
+	gallery_update();
+	window_frame_pacing();
 
 	for (int i = 0; i < arrlen(view_window_arr); i++) {
 		struct view_window* vw = &view_window_arr[i];
 		window_view(vw);
 	}
+
+	const int n = arrlen(view_window_arr);
+	for (int i = 0; i < n; i++) {
+		struct view_window* vw = &view_window_arr[i];
+		if (!vw->do_clone) continue;
+		vw->do_clone = false;
+		clone_view_window(vw);
+	}
+
+	const ImGuiIO& io = ImGui::GetIO();
+	bool input = get_fly_state() != NULL || io.MouseDelta.x != 0 || io.MouseDelta.y != 0 || io.MouseWheel != 0 || io.InputQueueCharacters.Size > 0 || ImGui::IsAnyItemActive();
+	for (int i = 0; i < IM_ARRAYSIZE(io.MouseDown); i++) input = input || io.MouseDown[i];
+	g.python_idle_frames = input ? 0 : g.python_idle_frames + 1;
+	python_housekeeping();
+	python_release();
 }
 
 static inline float fremap(float i, float i0, float i1, float o0, float o1)
@@ -1070,109 +3506,842 @@ static inline float fremap(float i, float i0, float i1, float o0, float o1)
 	return o0 + ((i - i0) / (i1 - i0)) * (o1 - o0);
 }
 
-void iced_render(void)
+static void draw_view_quads(struct view* view, int n);
+
+// draws the rw x rh region at (rx,ry) of a width x height image of the view
+// into the currently bound framebuffer, using the camera of vw
+static void draw_view_region(struct view* view, struct view_window* vw, int width, int height, int rx, int ry, int rw, int rh)
 {
-	const int n = arrlen(view_window_arr);
+	const int px = vw->pixel_size+1;
+	glUseProgram(view->prg0); CHKGL;
+	if (view->dim == 2) {
+		const gbVec2 o = vw->d2.origin;
+		const float sc = vw->d2.scale * (float)px;
+		const float x0 = o.x - (float)width * sc * 0.5f + (float)rx * sc;
+		const float y0 = o.y - (float)height * sc * 0.5f + (float)ry * sc;
+		const float x1 = x0 + (float)rw * sc;
+		const float y1 = y0 + (float)rh * sc;
+		glUniform2f(0, x0, y0);
+		glUniform2f(1, x1, y1);
+	} else if (view->dim == 3) {
+		gbVec3 view_dir, view_u, view_v;
+		view33(vw, &view_dir, &view_u, &view_v);
+		float fov = vw->d3.fov;
+		const float su = tanf(fov*0.5f);
+		gb_vec3_muleq(&view_u, su);
+		gb_vec3_muleq(&view_v, (su / (float)width) * (float)height);
+		// the vertex shader spans [-1;1] of u/v; move and shrink that to
+		// the region
+		const float cx = -1.0f + (float)(2*rx + rw) / (float)width;
+		const float cy = -1.0f + (float)(2*ry + rh) / (float)height;
+		gbVec3 t;
+		gb_vec3_mul(&t, view_u, cx);
+		gb_vec3_add(&view_dir, view_dir, t);
+		gb_vec3_mul(&t, view_v, cy);
+		gb_vec3_add(&view_dir, view_dir, t);
+		gb_vec3_muleq(&view_u, (float)rw / (float)width);
+		gb_vec3_muleq(&view_v, (float)rh / (float)height);
+		glUniform3fv(0, 1, vw->d3.origin.e);
+		glUniform3fv(1, 1, view_dir.e);
+		glUniform3fv(2, 1, view_u.e);
+		glUniform3fv(3, 1, view_v.e);
+
+		const struct lighting* li = &vw->lighting;
+		gbVec3 light_pos[MAX_LIGHTS];
+		gbVec3 light_color[MAX_LIGHTS];
+		int n_lights = 0;
+		for (int i = 0; i < MAX_LIGHTS; i++) {
+			const struct light* l = &li->lights[i];
+			if (!l->enabled) continue;
+			light_pos[n_lights] = l->position;
+			if (l->follow_camera) gb_vec3_addeq(&light_pos[n_lights], vw->d3.origin);
+			light_color[n_lights] = l->color;
+			n_lights++;
+		}
+		glUniform1i(10, n_lights);
+		glUniform1i(11, li->shadow_steps);
+		glUniform1f(12, li->penumbra);
+		glUniform1i(13, li->ao_taps);
+		glUniform1f(14, li->ao_step);
+		glUniform1f(15, li->ambient);
+		if (n_lights > 0) {
+			glUniform3fv(16, n_lights, light_pos[0].e);
+			glUniform3fv(20, n_lights, light_color[0].e);
+		}
+		glUniform1i(24, li->shading);
+		glUniform1f(25, li->exposure);
+		glUniform1i(26, li->tonemap);
+		glUniform1i(27, gb_max(1, li->heat_max));
+
+		// angle a pixel spans, for the adaptive epsilon
+		const struct march* m = &vw->march;
+		const float pixel_cone = (2.0f * su) / (float)width;
+		glUniform1i(28, m->kernel);
+		glUniform1f(29, m->relaxation);
+		glUniform1f(30, m->far);
+		glUniform1f(31, m->adaptive_epsilon ? pixel_cone : 0.0f);
+		glUniform1i(32, m->max_steps);
+	} else {
+		assert(!"bad");
+	}
+
+	draw_view_quads(view, 1);
+}
+
+// draws the view's program over the viewport with the buffers it uses bound;
+// the caller sets the program's camera uniforms. n > 1 draws that many quads
+// in one multi-draw, for programs that tell them apart by gl_DrawID
+static void draw_view_quads(struct view* view, int n)
+{
+	if (view->uses_params) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, view->params_buffer); CHKGL;
+	}
+	if (view->uses_fallback) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, view->ir_buffer); CHKGL;
+	}
+	if (view->uses_palette) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, view->palette_buffer); CHKGL;
+	}
+	glBindVertexArray(g.vao0); CHKGL;
+	if (n == 1) {
+		glDrawArrays(GL_TRIANGLES, 0, 6); CHKGL;
+	} else {
+		static GLint* first_arr;
+		static GLsizei* count_arr;
+		while (arrlen(first_arr) < n) {
+			arrput(first_arr, 0);
+			arrput(count_arr, 6);
+		}
+		glMultiDrawArrays(GL_TRIANGLES, first_arr, count_arr, n); CHKGL;
+	}
+	glBindVertexArray(0); CHKGL;
+	if (view->uses_params) {
+		if (view->params_fence != NULL) {
+			glDeleteSync(view->params_fence); CHKGL;
+		}
+		view->params_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); CHKGL;
+	}
+}
+
+static void draw_view(struct view* view, struct view_window* vw, int fb_width, int fb_height)
+{
+	draw_view_region(view, vw, fb_width, fb_height, 0, 0, fb_width, fb_height);
+}
+
+// renders a 3D view into render target index in FRAGMENT_MAIN_3D's passes;
+// without geometry only the shading pass runs, over the G-buffer the last
+// geometry pass left
+static void draw_view_deferred(struct view* view, struct view_window* vw, struct render_result* rr, bool geometry)
+{
+	assert(view->dim == 3);
+	const int target = rr->target;
+	const int fb_width = rr->width;
+	const int fb_height = rr->height;
+	glUseProgram(view->prg0); CHKGL;
+	if (geometry) {
+		glBindFramebuffer(GL_FRAMEBUFFER, render_target_gbuffer(target)); CHKGL;
+		glViewport(0, 0, fb_width, fb_height);
+		glUniform1i(4, 1); CHKGL;
+		glUniform1i(8, 1); CHKGL;
+		draw_view(view, vw, fb_width, fb_height);
+		glUniform1i(8, 0); CHKGL;
+	}
+
+	const struct render_target* rt = &render_target_arr[target];
+	assert(rt->gbuffer_framebuffer != 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, rt->framebuffer); CHKGL;
+	glViewport(0, 0, fb_width, fb_height);
+	glUniform1i(4, 2); CHKGL;
+	for (int i = 0; i < 2; i++) {
+		glActiveTexture(GL_TEXTURE1+i); CHKGL;
+		glBindTexture(GL_TEXTURE_2D, rt->gbuffer_textures[i]); CHKGL;
+	}
+	const bool collect_cost = vw->lighting.shading >= SHADING_STEPS;
+	if (collect_cost) {
+		const GLsizeiptr size = COST_METRICS * COST_STRIDE * sizeof(GLuint);
+		if (rr->cost_buffer == 0) {
+			glGenBuffers(1, &rr->cost_buffer); CHKGL;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, rr->cost_buffer); CHKGL;
+			glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_READ); CHKGL;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, rr->cost_buffer); CHKGL;
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL); CHKGL;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); CHKGL;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, rr->cost_buffer); CHKGL;
+	}
+	draw_view(view, vw, fb_width, fb_height);
+	if (collect_cost) {
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT); CHKGL;
+		if (rr->cost_fence != NULL) {
+			glDeleteSync(rr->cost_fence); CHKGL;
+		}
+		rr->cost_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); CHKGL;
+	}
+	for (int i = 0; i < 2; i++) {
+		glActiveTexture(GL_TEXTURE1+i); CHKGL;
+		glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	}
+	glActiveTexture(GL_TEXTURE0); CHKGL;
+	glUniform1i(4, 0); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+}
+
+static int tile_view_compar(const void* a, const void* b)
+{
+	const int va = tile_arr[*(const int*)a].view;
+	const int vb = tile_arr[*(const int*)b].view;
+	return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+// renders the tiles tile_request() scheduled this frame into their atlas
+// slots; one multi-draw per view, with the rectangles of all of them uploaded
+// to TileDraws at once
+static void tile_cache_render(void)
+{
+	if (g.tiles_frame != g.frame || g.n_tiles_scheduled == 0) return;
+	static int* draw_arr; // tile_arr indices, grouped by view
+	arrsetlen(draw_arr, 0);
+	for (int i = 0; i < arrlen(tile_arr); i++) {
+		struct tile* t = &tile_arr[i];
+		if (!t->scheduled) continue;
+		t->scheduled = false;
+		t->ready = true;
+		arrput(draw_arr, i);
+	}
+	g.n_tiles_scheduled = 0;
+	const int n = arrlen(draw_arr);
+	qsort(draw_arr, n, sizeof *draw_arr, tile_view_compar);
+
+	static gbVec4 rect_arr[TILE_BUDGET*2];
+	assert(n <= TILE_BUDGET);
 	for (int i = 0; i < n; i++) {
-		struct view_window* vw = &view_window_arr[i];
+		const int index = draw_arr[i];
+		const struct tile* t = &tile_arr[index];
+		// world and clip space rectangles of the slot, gutter included
+		const double texel = ldexp(1.0, t->key.level);
+		const double tile_size = texel * (double)TILE_SIZE;
+		const double x0 = (double)t->key.x * tile_size - texel;
+		const double y0 = (double)t->key.y * tile_size - texel;
+		const double x1 = x0 + tile_size + 2.0*texel;
+		const double y1 = y0 + tile_size + 2.0*texel;
+		rect_arr[i*2] = gb_vec4((float)x0, (float)y0, (float)x1, (float)y1);
+		const float s = 2.0f / (float)TILE_ATLAS_SIZE;
+		const float cx0 = (float)((index % TILE_ATLAS_SLOTS) * TILE_SLOT) * s - 1.0f;
+		const float cy0 = (float)((index / TILE_ATLAS_SLOTS) * TILE_SLOT) * s - 1.0f;
+		rect_arr[i*2+1] = gb_vec4(cx0, cy0, cx0 + (float)TILE_SLOT * s, cy0 + (float)TILE_SLOT * s);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, g.tile_draw_buffer); CHKGL;
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, n * 2 * sizeof *rect_arr, rect_arr); CHKGL;
+	glBindBuffer(GL_UNIFORM_BUFFER, 0); CHKGL;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, g.tile_framebuffer); CHKGL;
+	glViewport(0, 0, TILE_ATLAS_SIZE, TILE_ATLAS_SIZE);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 0, g.tile_draw_buffer); CHKGL;
+	for (int i0 = 0; i0 < n;) {
+		const int view_index = tile_arr[draw_arr[i0]].view;
+		int i1 = i0+1;
+		while (i1 < n && tile_arr[draw_arr[i1]].view == view_index) i1++;
+		struct view* view = &view_arr[view_index];
+		glUseProgram(view->prg0); CHKGL;
+		glUniform1i(2, 1); CHKGL;
+		glUniform1i(3, i0); CHKGL;
+		draw_view_quads(view, i1 - i0);
+		glUniform1i(2, 0); CHKGL;
+		i0 = i1;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+}
 
-		struct view* view = get_view_window_view(vw);
-
-		const ImVec2 size = vw->canvas_size;
-		const int px = vw->pixel_size+1;
-		const int fb_width = (int)size.x / px;
-		const int fb_height = (int)size.y / px;
-
-		if (fb_width <= 0 || fb_height <= 0) continue;
-
-		bool do_render = (view->serial > vw->seen_serial) || (vw->serial > vw->seen_serial);
-
-		if (view->serial > vw->seen_serial) vw->seen_serial = view->serial;
-		if (vw->serial > vw->seen_serial) vw->seen_serial = vw->serial;
-
-		if (!vw->gl_initialized) {
-			glGenFramebuffers(1, &vw->framebuffer); CHKGL;
-			glGenTextures(1, &vw->texture); CHKGL;
-
-			vw->gl_initialized = true;
-			vw->fb_width = -1;
-			vw->fb_height = -1;
-		}
-
-		if (fb_width != vw->fb_width || fb_height != vw->fb_height) {
-			glBindTexture(GL_TEXTURE_2D, vw->texture); CHKGL;
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); CHKGL;
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
-			glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB, fb_width, fb_height, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, NULL); CHKGL;
-
-			#if 0
-			{
-				// upload debug texture
-				const int bpp = 3;
-				const int row_size0 = fb_width * bpp;
-				const int row_size = ((row_size0+3) >> 2) << 2;
-				const int stride = row_size - row_size0;
-				unsigned char* pixels = (unsigned char*)malloc(row_size*fb_height);
-				unsigned char* p = pixels;
-				for (int y = 0; y < fb_height; y++) {
-					for (int x = 0; x < fb_width; x++) {
-						int chk = ((x>>3) ^ (y>>3)) & 1;
-						p[0] = chk ? 255 : 0;
-						p[1] = chk ? 255 : 0;
-						p[2] = chk ?   0 : 255;
-						p += bpp;
-					}
-					p += stride;
-				}
-				glTexSubImage2D(GL_TEXTURE_2D, /*level=*/0, /*xOffset=*/0, /*yOffset=*/0, fb_width, fb_height, GL_RGB, GL_UNSIGNED_BYTE, pixels); CHKGL;
-				free(pixels);
+// reads back the costs draw_view_deferred() collected once they're ready;
+// never waits for the GPU
+static void render_result_read_cost(struct render_result* rr)
+{
+	if (rr->cost_fence == NULL) return;
+	const GLenum status = glClientWaitSync(rr->cost_fence, 0, 0); CHKGL;
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+	glDeleteSync(rr->cost_fence); CHKGL;
+	rr->cost_fence = NULL;
+
+	static GLuint data[COST_METRICS * COST_STRIDE];
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, rr->cost_buffer); CHKGL;
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof data, data); CHKGL;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); CHKGL;
+
+	const int n_pixels = rr->width * rr->height;
+	for (int metric = 0; metric < COST_METRICS; metric++) {
+		const GLuint* c = &data[metric * COST_STRIDE];
+		const GLuint* bins = &c[3];
+		struct cost_stats* st = &rr->cost[metric];
+		const uint64_t sum = (uint64_t)c[0] | ((uint64_t)c[1] << 32);
+		st->mean = (double)sum / (double)n_pixels;
+		st->max = (int)c[2];
+		// smallest cost that at least 99% of the pixels stay within
+		const int64_t n99 = ((int64_t)n_pixels * 99 + 99) / 100;
+		int64_t acc = 0;
+		st->p99 = COST_BINS-1;
+		for (int i = 0; i < COST_BINS; i++) {
+			acc += bins[i];
+			if (acc >= n99) {
+				st->p99 = i;
+				break;
 			}
-			#endif
+		}
+	}
+	rr->has_cost = true;
+}
+
+// offline render of a view at an arbitrary resolution. the image is rendered
+// tile by tile, and each finished row of tiles is streamed to the PNG writer,
+// so neither the GPU nor RAM ever holds the full image. with aa > 1 each tile
+// is first rendered at one sample per pixel (with a 1 pixel border) and then
+// refined with aa x aa samples where neighbours disagree (see FRAGMENT_MAIN).
+// 2D views keep the world-space width the window shows.
+static bool render_offline(struct view* view, struct view_window* vw0, int width, int height, int tile_size, int aa, const char* path)
+{
+	struct timespec t0 = timer_begin();
+	struct view_window vw = *vw0;
+	vw.pixel_size = 0;
+	if (view->dim == 2) {
+		const float ref_width = vw0->canvas_size.x > 0 ? vw0->canvas_size.x : 1024.0f;
+		vw.d2.scale = vw0->d2.scale * ref_width / (float)width;
+	}
+
+	struct pngw png;
+	if (pngw_open(&png, path, width, height) != 0) {
+		raise_errorf("%s: cannot open for writing", path);
+		return false;
+	}
+
+	GLuint textures[2], framebuffers[2];
+	glGenTextures(2, textures); CHKGL;
+	glGenFramebuffers(2, framebuffers); CHKGL;
+	const int bordered = tile_size+2;
+	glBindTexture(GL_TEXTURE_2D, textures[0]); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGBA32F, bordered, bordered, /*border=*/0, GL_RGBA, GL_FLOAT, NULL); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, textures[1]); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGBA8, tile_size, tile_size, /*border=*/0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); CHKGL;
+	for (int i = 0; i < 2; i++) {
+		// no mipmaps; texelFetch() on an incomplete texture returns zeros
+		glBindTexture(GL_TEXTURE_2D, textures[i]); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); CHKGL;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); CHKGL;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	for (int i = 0; i < 2; i++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]); CHKGL;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], /*level=*/0); CHKGL;
+		assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
 
+	const size_t stride = (size_t)width * 3;
+	uint8_t* strip = (uint8_t*)malloc(stride * tile_size);
+	assert(strip != NULL);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1); CHKGL;
+	glPixelStorei(GL_PACK_ROW_LENGTH, width); CHKGL;
+	for (int y0 = 0; y0 < height; y0 += tile_size) {
+		const int th = gb_min(tile_size, height - y0);
+		for (int x0 = 0; x0 < width; x0 += tile_size) {
+			const int tw = gb_min(tile_size, width - x0);
+			if (aa > 1) {
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]); CHKGL;
+				glViewport(0, 0, tw+2, th+2);
+				glUseProgram(view->prg0); CHKGL;
+				glUniform1i(8, 1); CHKGL;
+				draw_view_region(view, &vw, width, height, x0-1, y0-1, tw+2, th+2);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]); CHKGL;
+			glViewport(0, 0, tw, th);
+			glUseProgram(view->prg0); CHKGL;
+			glUniform1i(8, aa > 1 ? aa : 0); CHKGL;
+			glUniform2i(9, 1, 1); CHKGL;
+			glActiveTexture(GL_TEXTURE0); CHKGL;
+			glBindTexture(GL_TEXTURE_2D, textures[0]); CHKGL;
+			draw_view_region(view, &vw, width, height, x0, y0, tw, th);
 			glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
-			vw->fb_width = fb_width;
-			vw->fb_height = fb_height;
-			do_render = true;
+			glReadPixels(0, 0, tw, th, GL_RGB, GL_UNSIGNED_BYTE, strip + x0*3); CHKGL;
 		}
+		pngw_write_rows(&png, strip, th, stride);
+		printf("render: %s: %d/%d rows\n", path, y0+th, height);
+		fflush(stdout);
+	}
+	glPixelStorei(GL_PACK_ROW_LENGTH, 0); CHKGL;
+	glPixelStorei(GL_PACK_ALIGNMENT, 4); CHKGL;
+	glUseProgram(view->prg0); CHKGL;
+	glUniform1i(8, 0); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+
+	free(strip);
+	glDeleteFramebuffers(2, framebuffers); CHKGL;
+	glDeleteTextures(2, textures); CHKGL;
+
+	if (pngw_close(&png) != 0) {
+		raise_errorf("%s: write failed", path);
+		return false;
+	}
+	printf("render: %s: %dx%d in %fs\n", path, width, height, timer_end(t0));
+	return true;
+}
 
-		if (do_render) {
-			glBindFramebuffer(GL_FRAMEBUFFER, vw->framebuffer); CHKGL;
-			glViewport(0, 0, fb_width, fb_height);
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, vw->texture, /*level=*/0); CHKGL;
-			assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+// PNG encoder thread pool used by render_sequence(). the queue is bounded so
+// a slow disk eventually applies backpressure instead of eating all RAM.
+struct encode_job {
+	char* path;
+	uint8_t* pixels; // bottom-up rows as returned by glReadPixels()
+	int width, height;
+};
 
-			glUseProgram(view->prg0); CHKGL;
-			if (view->dim == 2) {
-				const gbVec2 o = vw->d2.origin;
-				const float sc = vw->d2.scale * (float)px;
-				const float dx = (float)fb_width * sc;
-				const float dy = (float)fb_height * sc;
-				const float x0 = o.x - dx*0.5;
-				const float y0 = o.y - dy*0.5;
-				const float x1 = o.x + dx*0.5;
-				const float y1 = o.y + dy*0.5;
-				glUniform2f(0, x0, y0);
-				glUniform2f(1, x1, y1);
-			} else if (view->dim == 3) {
-				gbVec3 view_dir, view_u, view_v;
-				view33(vw, &view_dir, &view_u, &view_v);
-				float fov = vw->d3.fov;
-				const float su = tanf(fov*0.5f);
-				gb_vec3_muleq(&view_u, su);
-				gb_vec3_muleq(&view_v, (su / (float)fb_width) * (float)fb_height);
-				glUniform3fv(0, 1, vw->d3.origin.e);
-				glUniform3fv(1, 1, view_dir.e);
-				glUniform3fv(2, 1, view_u.e);
-				glUniform3fv(3, 1, view_v.e);
-			} else {
-				assert(!"bad");
+#define ENCODER_MAX_THREADS (8)
+#define ENCODER_QUEUE_SIZE (16)
+
+static struct {
+	pthread_t threads[ENCODER_MAX_THREADS];
+	int n_threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_job;
+	pthread_cond_t cond_space;
+	struct encode_job queue[ENCODER_QUEUE_SIZE];
+	int head, count;
+	bool quit;
+	int n_failed;
+} encoder;
+
+static void* encoder_thread(void* arg)
+{
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&encoder.mutex);
+		while (encoder.count == 0 && !encoder.quit) pthread_cond_wait(&encoder.cond_job, &encoder.mutex);
+		if (encoder.count == 0) {
+			pthread_mutex_unlock(&encoder.mutex);
+			return NULL;
+		}
+		struct encode_job job = encoder.queue[encoder.head];
+		encoder.head = (encoder.head + 1) % ENCODER_QUEUE_SIZE;
+		encoder.count--;
+		pthread_cond_signal(&encoder.cond_space);
+		pthread_mutex_unlock(&encoder.mutex);
+
+		struct pngw png;
+		int err = pngw_open(&png, job.path, job.width, job.height);
+		if (err == 0) {
+			pngw_write_rows(&png, job.pixels, job.height, (size_t)job.width * 3);
+			err = pngw_close(&png);
+		}
+		if (err != 0) {
+			fprintf(stderr, "sequence: %s: write failed\n", job.path);
+			pthread_mutex_lock(&encoder.mutex);
+			encoder.n_failed++;
+			pthread_mutex_unlock(&encoder.mutex);
+		}
+		free(job.pixels);
+		free(job.path);
+	}
+}
+
+static void encoder_start(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	encoder.n_threads = gb_clamp((int)n, 1, ENCODER_MAX_THREADS);
+	encoder.head = 0;
+	encoder.count = 0;
+	encoder.quit = false;
+	encoder.n_failed = 0;
+	pthread_mutex_init(&encoder.mutex, NULL);
+	pthread_cond_init(&encoder.cond_job, NULL);
+	pthread_cond_init(&encoder.cond_space, NULL);
+	for (int i = 0; i < encoder.n_threads; i++) {
+		assert(pthread_create(&encoder.threads[i], NULL, encoder_thread, NULL) == 0);
+	}
+}
+
+// takes ownership of path and pixels
+static void encoder_push(char* path, uint8_t* pixels, int width, int height)
+{
+	pthread_mutex_lock(&encoder.mutex);
+	while (encoder.count == ENCODER_QUEUE_SIZE) pthread_cond_wait(&encoder.cond_space, &encoder.mutex);
+	struct encode_job* job = &encoder.queue[(encoder.head + encoder.count) % ENCODER_QUEUE_SIZE];
+	job->path = path;
+	job->pixels = pixels;
+	job->width = width;
+	job->height = height;
+	encoder.count++;
+	pthread_cond_signal(&encoder.cond_job);
+	pthread_mutex_unlock(&encoder.mutex);
+}
+
+// drains the queue and joins the threads; returns the number of failed jobs
+static int encoder_finish(void)
+{
+	pthread_mutex_lock(&encoder.mutex);
+	encoder.quit = true;
+	pthread_cond_broadcast(&encoder.cond_job);
+	pthread_mutex_unlock(&encoder.mutex);
+	for (int i = 0; i < encoder.n_threads; i++) pthread_join(encoder.threads[i], NULL);
+	pthread_cond_destroy(&encoder.cond_space);
+	pthread_cond_destroy(&encoder.cond_job);
+	pthread_mutex_destroy(&encoder.mutex);
+	return encoder.n_failed;
+}
+
+// true if pattern has exactly one integer conversion (and no other)
+static bool is_frame_pattern(const char* pattern)
+{
+	int n = 0;
+	for (const char* p = pattern; *p; p++) {
+		if (*p != '%') continue;
+		p++;
+		if (*p == '%') continue;
+		while ('0' <= *p && *p <= '9') p++;
+		if (*p != 'd') return false;
+		n++;
+	}
+	return n == 1;
+}
+
+#define SEQUENCE_RING_SIZE (3)
+
+// renders n_frames frames along the camera path of vw. readback is pipelined
+// through a ring of PBOs: frame i is read into slot i%SEQUENCE_RING_SIZE and
+// only mapped SEQUENCE_RING_SIZE-1 frames later, by which time its fence has
+// normally signalled, so the GPU is never stalled by the copy. PNG encoding
+// and disk writes run on the encoder pool.
+static bool render_sequence(struct view* view, struct view_window* vw0, int width, int height, int n_frames, const char* pattern)
+{
+	const int n_keys = arrlen(vw0->camera_key_arr);
+	if (view->dim != 3 || n_keys == 0) return false;
+	if (width <= 0 || height <= 0 || n_frames <= 0) {
+		raise_errorf("bad sequence size %dx%d / %d frames", width, height, n_frames);
+		return false;
+	}
+	if (!is_frame_pattern(pattern)) {
+		raise_errorf("sequence path `%s` must contain exactly one %%d", pattern);
+		return false;
+	}
+
+	struct timespec t0 = timer_begin();
+
+	GLuint texture, framebuffer;
+	glGenTextures(1, &texture); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, texture); CHKGL;
+	glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB8, width, height, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, NULL); CHKGL;
+	glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+	glGenFramebuffers(1, &framebuffer); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); CHKGL;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, /*level=*/0); CHKGL;
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+	const size_t frame_size = (size_t)width * (size_t)height * 3;
+	GLuint pbos[SEQUENCE_RING_SIZE];
+	GLsync fences[SEQUENCE_RING_SIZE] = {0};
+	int slot_frame[SEQUENCE_RING_SIZE];
+	glGenBuffers(SEQUENCE_RING_SIZE, pbos); CHKGL;
+	for (int i = 0; i < SEQUENCE_RING_SIZE; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]); CHKGL;
+		glBufferData(GL_PIXEL_PACK_BUFFER, frame_size, NULL, GL_STREAM_READ); CHKGL;
+		slot_frame[i] = -1;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1); CHKGL;
+
+	encoder_start();
+
+	struct view_window vw = *vw0;
+	vw.pixel_size = 0;
+	for (int frame = 0; frame < n_frames + SEQUENCE_RING_SIZE; frame++) {
+		const int slot = frame % SEQUENCE_RING_SIZE;
+
+		// retire the frame rendered SEQUENCE_RING_SIZE frames ago
+		if (slot_frame[slot] >= 0) {
+			glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, ~(GLuint64)0); CHKGL;
+			glDeleteSync(fences[slot]); CHKGL;
+			fences[slot] = 0;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]); CHKGL;
+			const void* src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame_size, GL_MAP_READ_BIT); CHKGL;
+			uint8_t* pixels = (uint8_t*)malloc(frame_size);
+			assert(src != NULL && pixels != NULL);
+			memcpy(pixels, src, frame_size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER); CHKGL;
+			char path[1<<10];
+			snprintf(path, sizeof path, pattern, slot_frame[slot]);
+			encoder_push(cstrdup(path), pixels, width, height);
+			slot_frame[slot] = -1;
+		}
+
+		if (frame >= n_frames) continue;
+
+		const float u = n_frames > 1 ? (float)frame / (float)(n_frames-1) : 0.0f;
+		const struct camera_key k = camera_path_eval(vw0->camera_key_arr, n_keys, u);
+		vw.d3.origin = k.origin;
+		vw.d3.fov = k.fov;
+		vw.d3.pitch = k.pitch;
+		vw.d3.yaw = k.yaw;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); CHKGL;
+		glViewport(0, 0, width, height);
+		draw_view(view, &vw, width, height);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]); CHKGL;
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0); CHKGL;
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); CHKGL;
+		slot_frame[slot] = frame;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0); CHKGL;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+	glPixelStorei(GL_PACK_ALIGNMENT, 4); CHKGL;
+
+	const int n_failed = encoder_finish();
+
+	glDeleteBuffers(SEQUENCE_RING_SIZE, pbos); CHKGL;
+	glDeleteFramebuffers(1, &framebuffer); CHKGL;
+	glDeleteTextures(1, &texture); CHKGL;
+
+	const double dt = timer_end(t0);
+	g.sequence.fps = (double)n_frames / dt;
+	printf("sequence: %d frames of %dx%d in %fs (%.2f fps)\n", n_frames, width, height, dt, g.sequence.fps);
+	if (n_failed > 0) {
+		raise_errorf("sequence: %d frame(s) failed to write", n_failed);
+		return false;
+	}
+	return true;
+}
+
+void iced_render(void)
+{
+	// release unreferenced results beyond the spare count, oldest first
+	for (;;) {
+		int n_spare = 0;
+		int oldest = -1;
+		for (int i = 0; i < arrlen(render_result_arr); i++) {
+			struct render_result* rr = &render_result_arr[i];
+			if (!rr->in_use || rr->last_used_frame >= g.frame) continue;
+			n_spare++;
+			if (oldest < 0 || rr->last_used_frame < render_result_arr[oldest].last_used_frame) oldest = i;
+		}
+		if (n_spare <= RENDER_RESULT_SPARE) break;
+		struct render_result* rr = &render_result_arr[oldest];
+		render_target_release(rr->target);
+		if (rr->cost_fence != NULL) {
+			glDeleteSync(rr->cost_fence); CHKGL;
+		}
+		glDeleteBuffers(1, &rr->cost_buffer); CHKGL;
+		memset(rr, 0, sizeof *rr);
+		rr->target = -1;
+	}
+	render_target_trim(RENDER_TARGET_BUDGET);
+
+	for (int i = 0; i < arrlen(render_result_arr); i++) {
+		render_result_read_cost(&render_result_arr[i]);
+	}
+
+	const int n = arrlen(render_result_arr);
+	for (int i = 0; i < n; i++) {
+		struct render_result* rr = &render_result_arr[i];
+		if (!rr->in_use || !(rr->dirty || rr->reshade)) continue;
+		const bool geometry = rr->dirty;
+		rr->dirty = false;
+		rr->reshade = false;
+
+		struct view_window* vw = &view_window_arr[rr->owner];
+		draw_view_deferred(get_view_window_view(vw), vw, rr, geometry);
+	}
+
+	tile_cache_render();
+
+	for (int i = 0; i < arrlen(view_window_arr); i++) {
+		struct view_window* vw = &view_window_arr[i];
+		if (!vw->do_render_offline) continue;
+		vw->do_render_offline = false;
+		const int width = g.offline.size[0];
+		const int height = g.offline.size[1];
+		const int tile_size = g.offline.tile_size;
+		if (width <= 0 || height <= 0 || tile_size <= 0) {
+			raise_errorf("bad render size %dx%d / tile %d", width, height, tile_size);
+			continue;
+		}
+		render_offline(get_view_window_view(vw), vw, width, height, tile_size, g.offline.aa, g.offline.path);
+	}
+
+	for (int i = 0; i < arrlen(view_window_arr); i++) {
+		struct view_window* vw = &view_window_arr[i];
+		if (!vw->do_render_sequence) continue;
+		vw->do_render_sequence = false;
+		render_sequence(get_view_window_view(vw), vw, g.sequence.size[0], g.sequence.size[1], g.sequence.n_frames, g.sequence.path);
+	}
+}
+
+// headless benchmark runner used by `make bench` (see bench.py); renders each
+// view of the world module offscreen at fixed resolutions and writes the
+// measurements to output_path as JSON
+int iced_bench(const char* output_path)
+{
+	static const int resolutions[][2] = { {256,256}, {1024,1024} };
+	const int n_frames = 10;
+
+	python_acquire();
+
+	if (!g.python_initialized || g.has_error) {
+		fprintf(stderr, "bench: world `%s` failed to load\n", g.world_module_name);
+		return EXIT_FAILURE;
+	}
+
+	PyObject* pr = NULL;
+	PyObject* pfn = PyObject_GetAttrString(g.python_world_module, "viewlist");
+	if (pfn != NULL) {
+		pr = PyObject_CallObject(pfn, NULL);
+		Py_DECREF(pfn);
+	}
+	PyObject* it = pr != NULL ? PyObject_GetIter(pr) : NULL;
+	if (it == NULL) {
+		fprintf(stderr, "bench: `viewlist()` failed\n");
+		Py_XDECREF(pr);
+		return EXIT_FAILURE;
+	}
+
+	FILE* out = fopen(output_path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "bench: %s: cannot open for writing\n", output_path);
+		Py_DECREF(it);
+		Py_DECREF(pr);
+		return EXIT_FAILURE;
+	}
+
+	GLuint framebuffer, texture, query;
+	glGenFramebuffers(1, &framebuffer); CHKGL;
+	glGenTextures(1, &texture); CHKGL;
+	glGenQueries(1, &query); CHKGL;
+
+	int exit_code = EXIT_SUCCESS;
+	fprintf(out, "{\"world\": \"%s\", \"frames\": %d, \"results\": [\n", g.world_module_name, n_frames);
+	bool first = true;
+	PyObject* item;
+	while ((item = PyIter_Next(it)) != NULL) {
+		PyObject* pname = PyObject_GetAttrString(item, "name");
+		PyObject* pdim = PyObject_GetAttrString(item, "dim");
+		Py_DECREF(item);
+		if (pname == NULL || pdim == NULL) {
+			Py_XDECREF(pname);
+			Py_XDECREF(pdim);
+			continue;
+		}
+
+		struct view view = {0};
+		view.name = cstrdup(PyUnicode_AsUTF8(pname));
+		view.dim = PyLong_AsLong(pdim);
+		Py_DECREF(pname);
+		Py_DECREF(pdim);
+
+		printf("bench: %s ...\n", view.name);
+		fflush(stdout);
+
+		g.has_error = false;
+		reload_view(&view);
+
+		fprintf(out, "%s\t{\"name\": \"%s\", \"dim\": %d", first ? "" : ",\n", view.name, view.dim);
+		first = false;
+		if (g.has_error || view.prg0 == 0) {
+			fprintf(out, ", \"error\": true}");
+			exit_code = EXIT_FAILURE;
+			view_free(&view);
+			if (!g.python_initialized) break;
+			continue;
+		}
+		fprintf(out, ", \"codegen_s\": %f, \"source_bytes\": %zu, \"compile_s\": %f, \"gpu_ms\": {",
+			g.duration_exec,
+			g.source_size,
+			g.duration_compile);
+
+		struct view_window vw = {0};
+		view_window_reset_camera(&vw, view.dim);
+		lighting_reset(&vw.lighting);
+		march_reset(&vw.march);
+
+		// 3D views are also timed with the relaxed march kernel, as
+		// "<size> relaxed"
+		const int n_kernels = view.dim == 3 ? 2 : 1;
+		for (int ri = 0; ri < ARRAY_LENGTH(resolutions) * n_kernels; ri++) {
+			const int width = resolutions[ri % ARRAY_LENGTH(resolutions)][0];
+			const int height = resolutions[ri % ARRAY_LENGTH(resolutions)][1];
+			const bool relaxed = ri >= ARRAY_LENGTH(resolutions);
+			if (relaxed) {
+				vw.march.kernel = MARCH_RELAXED;
+				vw.march.adaptive_epsilon = true;
 			}
+			glBindTexture(GL_TEXTURE_2D, texture); CHKGL;
+			glTexImage2D(GL_TEXTURE_2D, /*level=*/0, GL_RGB, width, height, /*border=*/0, GL_RGB, GL_UNSIGNED_BYTE, NULL); CHKGL;
+			glBindTexture(GL_TEXTURE_2D, 0); CHKGL;
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer); CHKGL;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, /*level=*/0); CHKGL;
+			assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+			glViewport(0, 0, width, height);
 
-			glBindVertexArray(g.vao0); CHKGL;
-			glDrawArrays(GL_TRIANGLES, 0, 6); CHKGL;
-			glBindVertexArray(0); CHKGL;
+			// warm-up frame; some drivers defer part of the compile to first use
+			draw_view(&view, &vw, width, height);
+			glFinish();
 
+			glBeginQuery(GL_TIME_ELAPSED, query); CHKGL;
+			for (int i = 0; i < n_frames; i++) draw_view(&view, &vw, width, height);
+			glEndQuery(GL_TIME_ELAPSED); CHKGL;
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns); CHKGL;
 			glBindFramebuffer(GL_FRAMEBUFFER, 0); CHKGL;
+
+			fprintf(out, "%s\"%dx%d%s\": %f", ri > 0 ? ", " : "", width, height, relaxed ? " relaxed" : "", (1e-6 * (double)ns) / (double)n_frames);
+		}
+		fprintf(out, "}}");
+		fflush(out);
+
+		view_free(&view);
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+
+	glDeleteQueries(1, &query);
+	glDeleteTextures(1, &texture);
+	glDeleteFramebuffers(1, &framebuffer);
+	Py_DECREF(it);
+	Py_DECREF(pr);
+
+	return exit_code;
+}
+
+// headless offline render of a view with its default camera (--render)
+int iced_render_view(const char* view_name, int width, int height, const char* path)
+{
+	python_acquire();
+	if (!g.python_initialized || g.has_error) {
+		fprintf(stderr, "render: world `%s` failed to load\n", g.world_module_name);
+		return EXIT_FAILURE;
+	}
+
+	int dim = 0;
+	PyObject* pfn = PyObject_GetAttrString(g.python_world_module, "viewlist");
+	PyObject* pr = pfn != NULL ? PyObject_CallObject(pfn, NULL) : NULL;
+	PyObject* it = pr != NULL ? PyObject_GetIter(pr) : NULL;
+	if (it != NULL) {
+		PyObject* item;
+		while ((item = PyIter_Next(it)) != NULL) {
+			PyObject* pname = PyObject_GetAttrString(item, "name");
+			PyObject* pdim = PyObject_GetAttrString(item, "dim");
+			if (pname != NULL && pdim != NULL && strcmp(PyUnicode_AsUTF8(pname), view_name) == 0) {
+				dim = PyLong_AsLong(pdim);
+			}
+			Py_XDECREF(pdim);
+			Py_XDECREF(pname);
+			Py_DECREF(item);
 		}
+		Py_DECREF(it);
+	}
+	Py_XDECREF(pr);
+	Py_XDECREF(pfn);
+	if (dim == 0) {
+		fprintf(stderr, "render: no view named `%s`\n", view_name);
+		return EXIT_FAILURE;
+	}
+
+	open_view(view_name, dim);
+	if (g.has_error) return EXIT_FAILURE;
+	struct view_window* vw = &view_window_arr[arrlen(view_window_arr)-1];
+	if (!render_offline(get_view_window_view(vw), vw, width, height, g.offline.tile_size, g.offline.aa, path)) {
+		return EXIT_FAILURE;
 	}
+	return EXIT_SUCCESS;
 }
@@ -2,9 +2,20 @@
 
 #include "gl3w.h"
 
+void iced_set_world(const char* module_name);
+void iced_set_codegen_workers(int n); // -1: pick from core count
+void iced_set_glsl_budget(int soft_lines, int hard_lines);
 void iced_init(void);
 void iced_gui(void);
+// for session recording: whether the file watcher reloaded the world since
+// the last call. a replay turns the watcher off and has iced_gui() reload
+// where the recording did
+bool iced_watch_reloaded(void);
+void iced_set_watch(bool enable);
+void iced_request_reload(void);
 void iced_render(void);
+int iced_bench(const char* output_path);
+int iced_render_view(const char* view_name, int width, int height, const char* path);
 void fly_enable(bool enable);
 struct fly_state {
 	float dyaw;
@@ -17,6 +28,29 @@ struct fly_state {
 	bool cancel;
 };
 struct fly_state* get_fly_state(void);
+// mouse motion that arrived after iced_gui(), for late input sampling; turns
+// the camera being flown before iced_render() draws it
+void iced_fly_late(float dyaw, float dpitch);
+
+// frame pacing and input latency. the main loop timestamps input and frames
+// and measures when the GPU is done with each swap; the "Frame pacing" window
+// shows the numbers and changes the settings
+#define PACING_HISTORY (240) // frames
+#define PACING_BINS (64) // of the latency histogram, PACING_BIN_MS each
+#define PACING_BIN_MS (1.0f)
+struct frame_pacing {
+	bool late_input; // sample fly mode mouse motion again just before iced_render()
+	bool adaptive_vsync; // swap interval -1: tear rather than wait a whole frame when late
+	int max_queued_frames; // swaps the GPU may lag behind; 0 for no limit
+	bool has_adaptive_vsync; // whether the driver took swap interval -1
+
+	float frame_ms[PACING_HISTORY]; // frame interval, ring buffer
+	float latency_ms[PACING_HISTORY]; // motion-to-photon per frame with motion, ring buffer
+	int frame_cursor, latency_cursor;
+	int n_frames, n_latencies;
+	int histogram[PACING_BINS]; // latencies; the last bin is everything beyond
+};
+struct frame_pacing* get_frame_pacing(void);
 
 void imgui_own_wheel(void);
 
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #include "gl3w.h"
 
@@ -19,6 +20,7 @@
 #include "iced.h"
 
 static SDL_Window* window;
+static FILE* replay_file; // when replaying a session, see session_read_frame()
 
 static bool fly = false;
 static struct fly_state fly_state;
@@ -29,20 +31,474 @@ struct fly_state* get_fly_state(void)
 int fly_anchor_mx, fly_anchor_my;
 void fly_enable(bool enable)
 {
-	if (enable) {
-		memset(&fly_state, 0, sizeof fly_state);
-		SDL_GetMouseState(&fly_anchor_mx, &fly_anchor_my);
-	}
+	if (enable) memset(&fly_state, 0, sizeof fly_state);
+	fly = enable;
+	if (replay_file != NULL) return; // the mouse isn't ours
+	if (enable) SDL_GetMouseState(&fly_anchor_mx, &fly_anchor_my);
 	SDL_SetRelativeMouseMode(enable ? SDL_TRUE : SDL_FALSE);
 	if (!enable) {
 		SDL_WarpMouseInWindow(window, fly_anchor_mx, fly_anchor_my);
 	}
-	fly = enable;
 }
 
+static struct frame_pacing frame_pacing;
+struct frame_pacing* get_frame_pacing(void)
+{
+	return &frame_pacing;
+}
+
+static double now_ms(void)
+{
+	return (double)SDL_GetPerformanceCounter() * 1e3 / (double)SDL_GetPerformanceFrequency();
+}
+
+// SDL event timestamps are SDL_GetTicks() milliseconds
+static double event_ms(Uint32 timestamp)
+{
+	return now_ms() - (double)(Sint32)(SDL_GetTicks() - timestamp);
+}
+
+// swaps the GPU may still be working on; each gets a fence, for capping the
+// queue, and a timestamp query, for when the GPU got past the swap. that's
+// when the frame is ready for scanout, which then may take up to a refresh
+// interval more; the latencies are motion-to-swap-completion, so to speak
+#define PACING_IN_FLIGHT (8)
+struct pacing_frame {
+	bool pending;
+	GLsync fence;
+	GLuint query;
+	double motion_ms; // newest mouse motion the frame shows, or <0
+};
+static struct pacing_frame pacing_frame_arr[PACING_IN_FLIGHT];
+static int pacing_cursor; // next slot; the one after the newest frame
+static double gpu_clock_offset_ms; // GL_TIMESTAMP minus now_ms()
+static double last_swap_ms;
+
+static void pacing_add(float* ring, int* cursor, int* n, float value)
+{
+	ring[*cursor] = value;
+	*cursor = (*cursor + 1) % PACING_HISTORY;
+	if (*n < PACING_HISTORY) (*n)++;
+}
+
+static void pacing_collect_frame(struct pacing_frame* pf, bool wait)
+{
+	if (!pf->pending) return;
+	if (!wait) {
+		GLint available = 0;
+		glGetQueryObjectiv(pf->query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+	}
+	GLuint64 gpu_ns = 0;
+	glGetQueryObjectui64v(pf->query, GL_QUERY_RESULT, &gpu_ns);
+	glDeleteSync(pf->fence);
+	pf->fence = NULL;
+	pf->pending = false;
+	if (pf->motion_ms < 0) return;
+
+	struct frame_pacing* fp = &frame_pacing;
+	const float latency = (float)((double)gpu_ns * 1e-6 - gpu_clock_offset_ms - pf->motion_ms);
+	pacing_add(fp->latency_ms, &fp->latency_cursor, &fp->n_latencies, latency);
+	int bin = (int)(latency / PACING_BIN_MS);
+	if (bin < 0) bin = 0;
+	if (bin >= PACING_BINS) bin = PACING_BINS-1;
+	fp->histogram[bin]++;
+}
+
+// collects the frames the GPU is done with, oldest first, and holds the CPU
+// back while more than max_queued_frames swaps are in flight
+static void pacing_begin_frame(void)
+{
+	GLint64 gpu_ns;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+	gpu_clock_offset_ms = (double)gpu_ns * 1e-6 - now_ms();
+
+	const int max_queued = frame_pacing.max_queued_frames;
+	if (max_queued > 0 && max_queued < PACING_IN_FLIGHT) {
+		struct pacing_frame* pf = &pacing_frame_arr[(pacing_cursor + PACING_IN_FLIGHT - max_queued) % PACING_IN_FLIGHT];
+		if (pf->pending) glClientWaitSync(pf->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000 /* 100ms */);
+	}
+	for (int i = 0; i < PACING_IN_FLIGHT; i++) {
+		pacing_collect_frame(&pacing_frame_arr[(pacing_cursor + i) % PACING_IN_FLIGHT], false);
+	}
+}
+
+static void pacing_end_frame(double motion_ms)
+{
+	struct frame_pacing* fp = &frame_pacing;
+	const double t = now_ms();
+	if (last_swap_ms > 0) pacing_add(fp->frame_ms, &fp->frame_cursor, &fp->n_frames, (float)(t - last_swap_ms));
+	last_swap_ms = t;
+
+	struct pacing_frame* pf = &pacing_frame_arr[pacing_cursor];
+	pacing_collect_frame(pf, true);
+	if (pf->query == 0) glGenQueries(1, &pf->query);
+	glQueryCounter(pf->query, GL_TIMESTAMP);
+	pf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	pf->motion_ms = motion_ms;
+	pf->pending = true;
+	pacing_cursor = (pacing_cursor + 1) % PACING_IN_FLIGHT;
+}
+
+// session logs (--record, --replay). a log is SESSION_MAGIC, SESSION_VERSION,
+// the world module name and the imgui.ini the session started with (uint32
+// size and bytes each), then one record per frame until the end of the file:
+//
+//   uint8 flags (SESSION_*)
+//   float io.DeltaTime
+//   float io.DisplaySize, io.DisplayFramebufferScale (SESSION_DISPLAY)
+//   uint16 number of ImGui input events, then the events (session_write_event())
+//   fly_state (SESSION_FLY)
+//   float yaw and pitch motion for iced_fly_late() (SESSION_LATE)
+//
+// a replay feeds these back one record per frame, as fast as it goes, so
+// the GUI sees the same input on the same frames and the world reloads on
+// the same frames as recorded (with whatever is on disk by then). work that
+// has a time budget rather than a count (the gallery) doesn't replay exactly
+#define SESSION_MAGIC (0x4c524349) // "ICRL"
+#define SESSION_VERSION (1)
+enum {
+	SESSION_DISPLAY = 1<<0,
+	SESSION_FLY     = 1<<1,
+	SESSION_LATE    = 1<<2,
+	SESSION_RELOAD  = 1<<3, // the file watcher reloaded the world
+};
+
+struct session_frame {
+	uint8_t flags;
+	float delta_time;
+	float display[4];
+	ImVector<ImGuiInputEvent> events;
+	struct fly_state fly;
+	float late[2];
+};
+
+static void session_write(FILE* f, const void* p, size_t n)
+{
+	fwrite(p, n, 1, f);
+}
+
+static bool session_read(FILE* f, void* p, size_t n)
+{
+	return fread(p, n, 1, f) == 1;
+}
+
+#define X(NAME, TYPE) \
+static void session_write_##NAME(FILE* f, TYPE v) { session_write(f, &v, sizeof v); } \
+static bool session_read_##NAME(FILE* f, TYPE* v) { return session_read(f, v, sizeof *v); }
+X(u8, uint8_t)
+X(u16, uint16_t)
+X(u32, uint32_t)
+X(f32, float)
+#undef X
+
+static void session_write_event(FILE* f, const ImGuiInputEvent* e)
+{
+	session_write_u8(f, (uint8_t)e->Type);
+	switch (e->Type) {
+	case ImGuiInputEventType_MousePos:
+		session_write_f32(f, e->MousePos.PosX);
+		session_write_f32(f, e->MousePos.PosY);
+		session_write_u8(f, (uint8_t)e->MousePos.MouseSource);
+		break;
+	case ImGuiInputEventType_MouseWheel:
+		session_write_f32(f, e->MouseWheel.WheelX);
+		session_write_f32(f, e->MouseWheel.WheelY);
+		session_write_u8(f, (uint8_t)e->MouseWheel.MouseSource);
+		break;
+	case ImGuiInputEventType_MouseButton:
+		session_write_u8(f, (uint8_t)e->MouseButton.Button);
+		session_write_u8(f, e->MouseButton.Down);
+		session_write_u8(f, (uint8_t)e->MouseButton.MouseSource);
+		break;
+	case ImGuiInputEventType_Key:
+		session_write_u32(f, (uint32_t)e->Key.Key);
+		session_write_u8(f, e->Key.Down);
+		session_write_f32(f, e->Key.AnalogValue);
+		break;
+	case ImGuiInputEventType_Text:
+		session_write_u32(f, e->Text.Char);
+		break;
+	case ImGuiInputEventType_Focus:
+		session_write_u8(f, e->AppFocused.Focused);
+		break;
+	default:
+		assert(!"unhandled event type");
+	}
+}
+
+static bool session_read_event(FILE* f, ImGuiInputEvent* e)
+{
+	uint8_t type, u8[3];
+	uint32_t u32;
+	float f32[2];
+	if (!session_read_u8(f, &type)) return false;
+	e->Type = (ImGuiInputEventType)type;
+	switch (e->Type) {
+	case ImGuiInputEventType_MousePos:
+	case ImGuiInputEventType_MouseWheel:
+		if (!session_read_f32(f, &f32[0]) || !session_read_f32(f, &f32[1]) || !session_read_u8(f, &u8[0])) return false;
+		// MousePos and MouseWheel have the same layout
+		e->MousePos.PosX = f32[0];
+		e->MousePos.PosY = f32[1];
+		e->MousePos.MouseSource = (ImGuiMouseSource)u8[0];
+		return true;
+	case ImGuiInputEventType_MouseButton:
+		if (!session_read_u8(f, &u8[0]) || !session_read_u8(f, &u8[1]) || !session_read_u8(f, &u8[2])) return false;
+		e->MouseButton.Button = u8[0];
+		e->MouseButton.Down = u8[1];
+		e->MouseButton.MouseSource = (ImGuiMouseSource)u8[2];
+		return true;
+	case ImGuiInputEventType_Key:
+		if (!session_read_u32(f, &u32) || !session_read_u8(f, &u8[0]) || !session_read_f32(f, &f32[0])) return false;
+		e->Key.Key = (ImGuiKey)u32;
+		e->Key.Down = u8[0];
+		e->Key.AnalogValue = f32[0];
+		return true;
+	case ImGuiInputEventType_Text:
+		if (!session_read_u32(f, &u32)) return false;
+		e->Text.Char = u32;
+		return true;
+	case ImGuiInputEventType_Focus:
+		if (!session_read_u8(f, &u8[0])) return false;
+		e->AppFocused.Focused = u8[0];
+		return true;
+	default:
+		return false;
+	}
+}
+
+// queues a recorded event the way the backend did
+static void session_add_event(ImGuiIO& io, const ImGuiInputEvent* e)
+{
+	switch (e->Type) {
+	case ImGuiInputEventType_MousePos:
+		io.AddMouseSourceEvent(e->MousePos.MouseSource);
+		io.AddMousePosEvent(e->MousePos.PosX, e->MousePos.PosY);
+		break;
+	case ImGuiInputEventType_MouseWheel:
+		io.AddMouseSourceEvent(e->MouseWheel.MouseSource);
+		io.AddMouseWheelEvent(e->MouseWheel.WheelX, e->MouseWheel.WheelY);
+		break;
+	case ImGuiInputEventType_MouseButton:
+		io.AddMouseSourceEvent(e->MouseButton.MouseSource);
+		io.AddMouseButtonEvent(e->MouseButton.Button, e->MouseButton.Down);
+		break;
+	case ImGuiInputEventType_Key:
+		io.AddKeyAnalogEvent(e->Key.Key, e->Key.Down, e->Key.AnalogValue);
+		break;
+	case ImGuiInputEventType_Text:
+		io.AddInputCharacter(e->Text.Char);
+		break;
+	case ImGuiInputEventType_Focus:
+		io.AddFocusEvent(e->AppFocused.Focused);
+		break;
+	default:
+		break;
+	}
+}
+
+static void session_write_string(FILE* f, const char* p, size_t n)
+{
+	session_write_u32(f, (uint32_t)n);
+	session_write(f, p, n);
+}
+
+// returns a malloc'd, NUL terminated string
+static char* session_read_string(FILE* f, size_t* out_size)
+{
+	uint32_t n;
+	if (!session_read_u32(f, &n)) return NULL;
+	char* p = (char*)malloc(n+1);
+	if (!session_read(f, p, n) && n > 0) {
+		free(p);
+		return NULL;
+	}
+	p[n] = 0;
+	if (out_size != NULL) *out_size = n;
+	return p;
+}
+
+static FILE* session_record_open(const char* path, const char* world, const char* ini_path)
+{
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "record: %s: cannot open for writing\n", path);
+		exit(EXIT_FAILURE);
+	}
+	session_write_u32(f, SESSION_MAGIC);
+	session_write_u32(f, SESSION_VERSION);
+	session_write_string(f, world, strlen(world));
+	size_t ini_size = 0;
+	char* ini = ini_path != NULL ? (char*)SDL_LoadFile(ini_path, &ini_size) : NULL;
+	session_write_string(f, ini != NULL ? ini : "", ini_size);
+	SDL_free(ini);
+	return f;
+}
+
+static void session_write_frame(FILE* f, const struct session_frame* sf)
+{
+	session_write_u8(f, sf->flags);
+	session_write_f32(f, sf->delta_time);
+	if (sf->flags & SESSION_DISPLAY) {
+		for (int i = 0; i < 4; i++) session_write_f32(f, sf->display[i]);
+	}
+	session_write_u16(f, (uint16_t)sf->events.Size);
+	for (int i = 0; i < sf->events.Size; i++) session_write_event(f, &sf->events[i]);
+	if (sf->flags & SESSION_FLY) {
+		const struct fly_state* fs = &sf->fly;
+		session_write_f32(f, fs->dyaw);
+		session_write_f32(f, fs->dpitch);
+		session_write_f32(f, fs->dzoom);
+		session_write_u8(f, (uint8_t)(int8_t)fs->dforward);
+		session_write_u8(f, (uint8_t)(int8_t)fs->dright);
+		session_write_u8(f, (uint8_t)fs->speed);
+		session_write_u8(f, (fs->accept ? 1 : 0) | (fs->cancel ? 2 : 0));
+	}
+	if (sf->flags & SESSION_LATE) {
+		session_write_f32(f, sf->late[0]);
+		session_write_f32(f, sf->late[1]);
+	}
+}
+
+// false at the end of the log (or where it's cut short)
+static bool session_read_frame(FILE* f, struct session_frame* sf)
+{
+	sf->events.resize(0);
+	uint16_t n_events;
+	if (!session_read_u8(f, &sf->flags) || !session_read_f32(f, &sf->delta_time)) return false;
+	if (sf->flags & SESSION_DISPLAY) {
+		for (int i = 0; i < 4; i++) if (!session_read_f32(f, &sf->display[i])) return false;
+	}
+	if (!session_read_u16(f, &n_events)) return false;
+	for (int i = 0; i < n_events; i++) {
+		ImGuiInputEvent e;
+		if (!session_read_event(f, &e)) return false;
+		sf->events.push_back(e);
+	}
+	if (sf->flags & SESSION_FLY) {
+		struct fly_state* fs = &sf->fly;
+		uint8_t u8[4];
+		if (!session_read_f32(f, &fs->dyaw) || !session_read_f32(f, &fs->dpitch) || !session_read_f32(f, &fs->dzoom)) return false;
+		for (int i = 0; i < 4; i++) if (!session_read_u8(f, &u8[i])) return false;
+		fs->dforward = (int8_t)u8[0];
+		fs->dright = (int8_t)u8[1];
+		fs->speed = u8[2];
+		fs->accept = u8[3] & 1;
+		fs->cancel = u8[3] & 2;
+	}
+	if (sf->flags & SESSION_LATE) {
+		if (!session_read_f32(f, &sf->late[0]) || !session_read_f32(f, &sf->late[1])) return false;
+	}
+	return true;
+}
+
+static int float_compar(const void* a, const void* b)
+{
+	const float fa = *(const float*)a;
+	const float fb = *(const float*)b;
+	return fa < fb ? -1 : fa > fb ? 1 : 0;
+}
+
+static int session_write_results(const char* path, const char* log_path, const char* world, ImVector<float>& frame_ms)
+{
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "replay: %s: cannot open for writing\n", path);
+		return EXIT_FAILURE;
+	}
+	const int n = frame_ms.Size;
+	double sum = 0;
+	fprintf(out, "{\"log\": \"%s\", \"world\": \"%s\", \"frames\": %d, \"frame_ms\": [", log_path, world, n);
+	for (int i = 0; i < n; i++) {
+		fprintf(out, "%s%.3f", i > 0 ? ", " : "", frame_ms[i]);
+		sum += frame_ms[i];
+	}
+	qsort(frame_ms.Data, n, sizeof *frame_ms.Data, float_compar);
+	const double mean = n > 0 ? sum / n : 0.0;
+	const float p50 = n > 0 ? frame_ms[n/2] : 0.0f;
+	const float p95 = n > 0 ? frame_ms[(n*95)/100] : 0.0f;
+	const float max = n > 0 ? frame_ms[n-1] : 0.0f;
+	fprintf(out, "], \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"max_ms\": %.3f}\n", mean, p50, p95, max);
+	fclose(out);
+	printf("replay: %s: %d frames, mean %.2fms, p50 %.2fms, p95 %.2fms, max %.2fms\n", log_path, n, mean, p50, p95, max);
+	return EXIT_SUCCESS;
+}
+
+static void usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [--world <module>] [--workers <n>] [--glsl-budget <soft>,<hard>] [--bench <results.json>] [--render <view> <width>x<height> <out.png>] [--record <session.log>] [--replay <session.log> <results.json> [--headless]]\n", argv0);
+	exit(EXIT_FAILURE);
+}
 
 int main(int argc, char** argv)
 {
+	const char* world = NULL;
+	int n_workers = -1;
+	int glsl_budget[2] = {0,0};
+	const char* bench_output_path = NULL;
+	const char* render_view = NULL;
+	const char* render_path = NULL;
+	int render_width = 0, render_height = 0;
+	const char* record_path = NULL;
+	const char* replay_path = NULL;
+	const char* replay_output_path = NULL;
+	bool replay_headless = false;
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		if (strcmp(arg, "--world") == 0 && (i+1) < argc) {
+			world = argv[++i];
+		} else if (strcmp(arg, "--workers") == 0 && (i+1) < argc) {
+			n_workers = atoi(argv[++i]);
+		} else if (strcmp(arg, "--glsl-budget") == 0 && (i+1) < argc) {
+			if (sscanf(argv[++i], "%d,%d", &glsl_budget[0], &glsl_budget[1]) != 2) usage(argv[0]);
+		} else if (strcmp(arg, "--bench") == 0 && (i+1) < argc) {
+			bench_output_path = argv[++i];
+		} else if (strcmp(arg, "--render") == 0 && (i+3) < argc) {
+			render_view = argv[++i];
+			if (sscanf(argv[++i], "%dx%d", &render_width, &render_height) != 2) usage(argv[0]);
+			render_path = argv[++i];
+		} else if (strcmp(arg, "--record") == 0 && (i+1) < argc) {
+			record_path = argv[++i];
+		} else if (strcmp(arg, "--replay") == 0 && (i+2) < argc) {
+			replay_path = argv[++i];
+			replay_output_path = argv[++i];
+		} else if (strcmp(arg, "--headless") == 0) {
+			replay_headless = true;
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if ((replay_headless && replay_path == NULL) || (record_path != NULL && replay_path != NULL)) usage(argv[0]);
+	const bool headless = bench_output_path != NULL || render_view != NULL;
+
+	char* replay_ini = NULL;
+	size_t replay_ini_size = 0;
+	char* replay_world = NULL;
+	if (replay_path != NULL) {
+		replay_file = fopen(replay_path, "rb");
+		uint32_t magic = 0, version = 0;
+		if (replay_file == NULL || !session_read_u32(replay_file, &magic) || magic != SESSION_MAGIC || !session_read_u32(replay_file, &version)) {
+			fprintf(stderr, "replay: %s: not a session log\n", replay_path);
+			exit(EXIT_FAILURE);
+		}
+		if (version != SESSION_VERSION) {
+			fprintf(stderr, "replay: %s: version %u, expected %d\n", replay_path, version, SESSION_VERSION);
+			exit(EXIT_FAILURE);
+		}
+		replay_world = session_read_string(replay_file, NULL);
+		replay_ini = session_read_string(replay_file, &replay_ini_size);
+		if (replay_world == NULL || replay_ini == NULL) {
+			fprintf(stderr, "replay: %s: truncated header\n", replay_path);
+			exit(EXIT_FAILURE);
+		}
+		if (world == NULL) {
+			world = replay_world;
+		} else if (strcmp(world, replay_world) != 0) {
+			fprintf(stderr, "replay: %s was recorded with world `%s`, replaying with `%s`\n", replay_path, replay_world, world);
+		}
+	}
+
 	wchar_t* program = Py_DecodeLocale(argv[0], NULL);
 	if (program == NULL) {
 		fprintf(stderr, "Fatal error: cannot decode argv[0]\n");
@@ -68,11 +524,13 @@ int main(int argc, char** argv)
 		"ICed",
 		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 		1920, 1080,
-		SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
+		SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | (headless || replay_headless ? SDL_WINDOW_HIDDEN : 0));
 	assert(window != NULL);
 	SDL_GLContext glctx = SDL_GL_CreateContext(window);
 
+	frame_pacing.has_adaptive_vsync = SDL_GL_SetSwapInterval(-1) == 0;
 	SDL_GL_SetSwapInterval(1);
+	bool adaptive_vsync = false;
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -85,16 +543,56 @@ int main(int argc, char** argv)
 	io.Fonts->AddFontFromFileTTF("Roboto-Regular.ttf", 18);
 	io.Fonts->Build();
 
+	if (replay_file != NULL) {
+		// the window layout the recording started with, not ours
+		io.IniFilename = NULL;
+		ImGui::LoadIniSettingsFromMemory(replay_ini, replay_ini_size);
+	}
+
 	GLint gl_major_version, gl_minor_version;
 	glGetIntegerv(GL_MAJOR_VERSION, &gl_major_version);
 	glGetIntegerv(GL_MINOR_VERSION, &gl_minor_version);
 	printf("OpenGL%d.%d / GLSL%s\n", gl_major_version, gl_minor_version, glGetString(GL_SHADING_LANGUAGE_VERSION));
 
+	if (world != NULL) iced_set_world(world);
+	iced_set_codegen_workers(n_workers);
+	if (glsl_budget[1] > 0) iced_set_glsl_budget(glsl_budget[0], glsl_budget[1]);
 	iced_init();
 
+	if (headless) {
+		const int exit_code =
+			bench_output_path != NULL
+			? iced_bench(bench_output_path)
+			: iced_render_view(render_view, render_width, render_height, render_path);
+		PyMem_RawFree(program);
+		return exit_code;
+	}
+
+	FILE* record_file = NULL;
+	if (record_path != NULL) record_file = session_record_open(record_path, world != NULL ? world : "world", io.IniFilename);
+	ImU32 record_event_id = 0; // first event not yet recorded
+	ImVec2 record_display[2] = {};
+	struct session_frame session_frame;
+	ImVector<float> replay_frame_ms;
+	if (replay_file != NULL) {
+		iced_set_watch(false);
+		SDL_GL_SetSwapInterval(0);
+	}
+
 	int exiting = 0;
 	while (!exiting) {
+		const double frame_start_ms = now_ms();
+		if (replay_file != NULL) {
+			if (!session_read_frame(replay_file, &session_frame)) break;
+			if (session_frame.flags & SESSION_RELOAD) iced_request_reload();
+		} else if (frame_pacing.adaptive_vsync != adaptive_vsync) {
+			adaptive_vsync = frame_pacing.adaptive_vsync;
+			if (!adaptive_vsync || SDL_GL_SetSwapInterval(-1) != 0) SDL_GL_SetSwapInterval(1);
+		}
+		pacing_begin_frame();
+
 		SDL_Event ev;
+		double motion_ms = -1;
 		float fly_dx = 0;
 		float fly_dy = 0;
 		float fly_wheel = 0; // hehe
@@ -102,7 +600,11 @@ int main(int argc, char** argv)
 		while (SDL_PollEvent(&ev)) {
 			if ((ev.type == SDL_QUIT) || (ev.type == SDL_WINDOWEVENT && ev.window.event == SDL_WINDOWEVENT_CLOSE)) {
 				exiting = 1;
-			} else {
+			} else if (replay_file == NULL) {
+				if (ev.type == SDL_MOUSEMOTION) {
+					const double t = event_ms(ev.motion.timestamp);
+					if (t > motion_ms) motion_ms = t;
+				}
 				if (fly) {
 					switch (ev.type) {
 					case SDL_KEYDOWN: {
@@ -173,13 +675,81 @@ int main(int argc, char** argv)
 		}
 
 		ImGui_ImplOpenGL4_NewFrame();
-		ImGui_ImplSDL2_NewFrame(!fly);
+		if (replay_file != NULL) {
+			const struct session_frame* sf = &session_frame;
+			if (sf->flags & SESSION_DISPLAY) {
+				io.DisplaySize = ImVec2(sf->display[0], sf->display[1]);
+				io.DisplayFramebufferScale = ImVec2(sf->display[2], sf->display[3]);
+			}
+			io.DeltaTime = sf->delta_time;
+			for (int i = 0; i < sf->events.Size; i++) session_add_event(io, &sf->events[i]);
+			if (sf->flags & SESSION_FLY) {
+				fly_state = sf->fly;
+				fly_stop = fly_state.accept || fly_state.cancel;
+			}
+		} else {
+			ImGui_ImplSDL2_NewFrame(!fly);
+		}
+		if (record_file != NULL) {
+			// the events the backend queued this frame; the queue may
+			// still hold some that NewFrame() trickled to the next
+			struct session_frame* sf = &session_frame;
+			sf->flags = 0;
+			sf->delta_time = io.DeltaTime;
+			if (io.DisplaySize.x != record_display[0].x || io.DisplaySize.y != record_display[0].y || io.DisplayFramebufferScale.x != record_display[1].x || io.DisplayFramebufferScale.y != record_display[1].y) {
+				record_display[0] = io.DisplaySize;
+				record_display[1] = io.DisplayFramebufferScale;
+				sf->flags |= SESSION_DISPLAY;
+				sf->display[0] = io.DisplaySize.x;
+				sf->display[1] = io.DisplaySize.y;
+				sf->display[2] = io.DisplayFramebufferScale.x;
+				sf->display[3] = io.DisplayFramebufferScale.y;
+			}
+			sf->events.resize(0);
+			const ImVector<ImGuiInputEvent>& queue = ImGui::GetCurrentContext()->InputEventsQueue;
+			for (int i = 0; i < queue.Size; i++) {
+				const ImGuiInputEvent* e = &queue[i];
+				if ((ImS32)(e->EventId - record_event_id) < 0) continue;
+				sf->events.push_back(*e);
+			}
+			record_event_id = ImGui::GetCurrentContext()->InputEventsNextEventId;
+			if (fly) {
+				sf->flags |= SESSION_FLY;
+				sf->fly = fly_state;
+			}
+		}
 		ImGui::NewFrame();
 
 		iced_gui();
 
 		ImGui::Render();
 
+		if (replay_file != NULL) {
+			if (session_frame.flags & SESSION_LATE) iced_fly_late(session_frame.late[0], session_frame.late[1]);
+		} else if (fly && !fly_stop && frame_pacing.late_input) {
+			// motion that arrived while the GUI was built; the rest of
+			// the events wait for the next frame
+			SDL_PumpEvents();
+			float dx = 0;
+			float dy = 0;
+			SDL_Event evs[64];
+			int n;
+			while ((n = SDL_PeepEvents(evs, 64, SDL_GETEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION)) > 0) {
+				for (int i = 0; i < n; i++) {
+					dx += evs[i].motion.xrel;
+					dy += evs[i].motion.yrel;
+					const double t = event_ms(evs[i].motion.timestamp);
+					if (t > motion_ms) motion_ms = t;
+				}
+			}
+			iced_fly_late(dx, dy);
+			if (record_file != NULL) {
+				session_frame.flags |= SESSION_LATE;
+				session_frame.late[0] = dx;
+				session_frame.late[1] = dy;
+			}
+		}
+
 		iced_render();
 
 		glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
@@ -189,15 +759,34 @@ int main(int argc, char** argv)
 		ImGui_ImplOpenGL4_RenderDrawData(ImGui::GetDrawData());
 
 		SDL_GL_SwapWindow(window);
+		pacing_end_frame(motion_ms);
+
+		if (record_file != NULL) {
+			if (iced_watch_reloaded()) session_frame.flags |= SESSION_RELOAD;
+			session_write_frame(record_file, &session_frame);
+		}
+		if (replay_file != NULL) {
+			glFinish();
+			replay_frame_ms.push_back((float)(now_ms() - frame_start_ms));
+		}
 
 		if (fly_stop) {
 			fly_enable(false);
 		}
 	}
 
+	int exit_code = EXIT_SUCCESS;
+	if (record_file != NULL) fclose(record_file);
+	if (replay_file != NULL) {
+		fclose(replay_file);
+		exit_code = session_write_results(replay_output_path, replay_path, world != NULL ? world : "world", replay_frame_ms);
+	}
+	free(replay_world);
+	free(replay_ini);
+
 	PyMem_RawFree(program);
 
-	return EXIT_SUCCESS;
+	return exit_code;
 }
 
 // quality of life wrappers; these are defined in imgui_internal.h which makes
@@ -0,0 +1,542 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "icir.h"
+
+enum op {
+	OP_UNKNOWN = 0,
+	OP_ROOT,
+	OP_MATERIAL,
+	OP_SUBSCENE,
+	OP_TRANSLATE2,
+	OP_SCALE2,
+	OP_CIRCLE2,
+	OP_TRANSLATE3,
+	OP_SPHERE3,
+	OP_BOX3,
+	OP_CYLINDER3,
+	OP_TORUS3,
+	OP_CAPPEDTORUS3,
+	OP_UNION,
+	OP_SUBTRACT,
+	OP_INTERSECT,
+	OP_SMOOTH_UNION,
+	OP_SMOOTH_SUBTRACT,
+	OP_SMOOTH_INTERSECT,
+};
+
+static const char* op_names[] = {
+	[OP_UNKNOWN]          = "",
+	[OP_ROOT]             = "root",
+	[OP_MATERIAL]         = "material",
+	[OP_SUBSCENE]         = "subscene",
+	[OP_TRANSLATE2]       = "translate2",
+	[OP_SCALE2]           = "scale2",
+	[OP_CIRCLE2]          = "circle2",
+	[OP_TRANSLATE3]       = "translate3",
+	[OP_SPHERE3]          = "sphere3",
+	[OP_BOX3]             = "box3",
+	[OP_CYLINDER3]        = "cylinder3",
+	[OP_TORUS3]           = "torus3",
+	[OP_CAPPEDTORUS3]     = "cappedtorus3",
+	[OP_UNION]            = "union",
+	[OP_SUBTRACT]         = "subtract",
+	[OP_INTERSECT]        = "intersect",
+	[OP_SMOOTH_UNION]     = "smooth_union",
+	[OP_SMOOTH_SUBTRACT]  = "smooth_subtract",
+	[OP_SMOOTH_INTERSECT] = "smooth_intersect",
+};
+
+int icir_open(struct icir* ir, const void* data, size_t size)
+{
+	memset(ir, 0, sizeof *ir);
+	const int32_t* h = (const int32_t*)data;
+	if (size < 8*sizeof(int32_t)) return -1;
+	if (h[0] != ICIR_MAGIC || h[1] != ICIR_VERSION) return -1;
+	ir->dim = h[2];
+	ir->n_nodes = h[3];
+	ir->n_params = h[4];
+	ir->n_materials = h[5];
+	ir->n_types = h[6];
+	const int types_size = h[7];
+	if (ir->n_nodes < 1 || ir->n_params < 0 || ir->n_materials < 0 || ir->n_types < 1 || types_size < 0 || (types_size & 3)) return -1;
+	const size_t expected_size =
+		8*sizeof(int32_t) + types_size +
+		(size_t)ir->n_nodes * (ICIR_NODE_SIZE*sizeof(int32_t) + 6*sizeof(float)) +
+		(size_t)ir->n_params * sizeof(float) +
+		(size_t)ir->n_materials * 6*sizeof(float);
+	if (size != expected_size) return -1;
+
+	const char* types = (const char*)(h + 8);
+	ir->nodes = (const int32_t*)(types + types_size);
+	ir->bounds = (const float*)(ir->nodes + ir->n_nodes*ICIR_NODE_SIZE);
+	ir->params = ir->bounds + ir->n_nodes*6;
+	ir->materials = ir->params + ir->n_params;
+
+	ir->type_names = (const char**)calloc(ir->n_types, sizeof *ir->type_names);
+	ir->ops = (uint8_t*)calloc(ir->n_types, sizeof *ir->ops);
+	const char* p = types;
+	for (int i = 0; i < ir->n_types; i++) {
+		const char* nul = (const char*)memchr(p, 0, types + types_size - p);
+		if (nul == NULL) {
+			icir_close(ir);
+			return -1;
+		}
+		const size_t n = nul - p;
+		ir->type_names[i] = p;
+		for (int op = 1; op < (int)(sizeof(op_names)/sizeof(op_names[0])); op++) {
+			if (strcmp(p, op_names[op]) == 0) ir->ops[i] = op;
+		}
+		if (ir->ops[i] == OP_UNKNOWN) ir->n_unknown_types++;
+		p += n+1;
+	}
+
+	for (int i = 0; i < ir->n_nodes; i++) {
+		const int32_t* n = icir_node(ir, i);
+		if (n[ICIR_TYPE] < 0 || n[ICIR_TYPE] >= ir->n_types) goto bad;
+		if (n[ICIR_PARENT] >= i) goto bad;
+		if (n[ICIR_FIRST_CHILD] >= 0 && n[ICIR_FIRST_CHILD] <= i) goto bad;
+		if (n[ICIR_NEXT_SIBLING] >= 0 && n[ICIR_NEXT_SIBLING] <= i) goto bad;
+		if (n[ICIR_FIRST_CHILD] >= ir->n_nodes || n[ICIR_NEXT_SIBLING] >= ir->n_nodes) goto bad;
+		if (n[ICIR_REF] >= 0 && (n[ICIR_REF] <= i || n[ICIR_REF] >= ir->n_nodes)) goto bad;
+		if (n[ICIR_PARAM0] < 0 || n[ICIR_N_PARAMS] < 0 || n[ICIR_PARAM0] + n[ICIR_N_PARAMS] > ir->n_params) goto bad;
+		if (n[ICIR_MATERIAL] >= ir->n_materials) goto bad;
+	}
+	return 0;
+
+	bad:
+	icir_close(ir);
+	return -1;
+}
+
+void icir_close(struct icir* ir)
+{
+	free(ir->type_names);
+	free(ir->ops);
+	memset(ir, 0, sizeof *ir);
+}
+
+int icir_diff(const struct icir* a, const struct icir* b)
+{
+	if (a->dim != b->dim || a->n_nodes != b->n_nodes || a->n_types != b->n_types || a->n_params != b->n_params || a->n_materials != b->n_materials) {
+		return ICIR_CHANGED_STRUCTURE;
+	}
+	for (int i = 0; i < a->n_types; i++) {
+		if (strcmp(a->type_names[i], b->type_names[i]) != 0) return ICIR_CHANGED_STRUCTURE;
+	}
+	if (memcmp(a->nodes, b->nodes, (size_t)a->n_nodes*ICIR_NODE_SIZE*sizeof(int32_t)) != 0) {
+		return ICIR_CHANGED_STRUCTURE;
+	}
+	int changed = 0;
+	if (memcmp(a->params, b->params, (size_t)a->n_params*sizeof(float)) != 0) changed |= ICIR_CHANGED_PARAMS;
+	if (memcmp(a->materials, b->materials, (size_t)a->n_materials*6*sizeof(float)) != 0) changed |= ICIR_CHANGED_MATERIALS;
+	return changed;
+}
+
+struct res {
+	float d;
+	int m;
+	int has_d;
+	int has_m;
+};
+
+static inline float len2(float x, float y) { return sqrtf(x*x + y*y); }
+static inline float len3(float x, float y, float z) { return sqrtf(x*x + y*y + z*z); }
+static inline float minf(float a, float b) { return a < b ? a : b; }
+static inline float maxf(float a, float b) { return a > b ? a : b; }
+static inline float clampf(float x, float a, float b) { return minf(maxf(x, a), b); }
+static inline float mixf(float a, float b, float t) { return a + (b-a)*t; }
+
+// lower bound on the distance from q to anything inside node i's bounds
+static float bounds_distance(const struct icir* ir, int i, const float* q)
+{
+	const float* b = &ir->bounds[i*6];
+	float s = 0;
+	for (int a = 0; a < 3; a++) {
+		const float e = maxf(maxf(b[a] - q[a], q[a] - b[3+a]), 0.0f);
+		s += e*e;
+	}
+	return sqrtf(s);
+}
+
+// mirrors _Node.rjoin(); d0 is the child, d1 what has been joined so far
+static float join_d(int op, float d0, float d1, const float* a)
+{
+	switch (op) {
+	case OP_SUBTRACT: return maxf(-d0, d1);
+	case OP_INTERSECT: return maxf(d0, d1);
+	case OP_SMOOTH_UNION: {
+		const float k = a[0];
+		const float h = clampf(0.5f + 0.5f*(d1-d0)/k, 0.0f, 1.0f);
+		return mixf(d1, d0, h) - k*h*(1.0f-h);
+	}
+	case OP_SMOOTH_SUBTRACT: {
+		const float k = a[0];
+		const float h = clampf(0.5f - 0.5f*(d1+d0)/k, 0.0f, 1.0f);
+		return mixf(d1, -d0, h) + k*h*(1.0f-h);
+	}
+	case OP_SMOOTH_INTERSECT: {
+		const float k = a[0];
+		const float h = clampf(0.5f - 0.5f*(d1-d0)/k, 0.0f, 1.0f);
+		return mixf(d1, d0, h) + k*h*(1.0f-h);
+	}
+	default: return minf(d0, d1);
+	}
+}
+
+static int is_min_join(int op)
+{
+	switch (op) {
+	case OP_SUBTRACT:
+	case OP_INTERSECT:
+	case OP_SMOOTH_UNION:
+	case OP_SMOOTH_SUBTRACT:
+	case OP_SMOOTH_INTERSECT:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+static void eval_node(const struct icir* ir, int i, const float* p, struct res* r)
+{
+	const int32_t* n = icir_node(ir, i);
+	const int op = ir->ops[n[ICIR_TYPE]];
+	const float* a = &ir->params[n[ICIR_PARAM0]];
+	float q[3] = { p[0], p[1], p[2] };
+	memset(r, 0, sizeof *r);
+
+	switch (op) {
+	case OP_SUBSCENE:
+		eval_node(ir, n[ICIR_REF], q, r);
+		return;
+	case OP_MATERIAL:
+		r->has_m = 1;
+		r->m = n[ICIR_MATERIAL];
+		break;
+	case OP_TRANSLATE2:
+		q[0] += a[0];
+		q[1] += a[1];
+		break;
+	case OP_SCALE2:
+		q[0] /= a[0];
+		q[1] /= a[0];
+		break;
+	case OP_TRANSLATE3:
+		q[0] += a[0];
+		q[1] += a[1];
+		q[2] += a[2];
+		break;
+	case OP_CIRCLE2:
+		r->d = len2(q[0], q[1]) - a[0];
+		r->has_d = 1;
+		return;
+	case OP_SPHERE3:
+		r->d = len3(q[0], q[1], q[2]) - a[0];
+		r->has_d = 1;
+		return;
+	case OP_BOX3: {
+		const float qx = fabsf(q[0]) - a[0];
+		const float qy = fabsf(q[1]) - a[1];
+		const float qz = fabsf(q[2]) - a[2];
+		r->d = len3(maxf(qx,0), maxf(qy,0), maxf(qz,0)) + minf(maxf(qx, maxf(qy, qz)), 0);
+		r->has_d = 1;
+		return;
+	}
+	case OP_CYLINDER3:
+		r->d = len2(q[0], q[2]) - a[0];
+		r->has_d = 1;
+		return;
+	case OP_TORUS3:
+		r->d = len2(len2(q[0], q[2]) - a[0], q[1]) - a[1];
+		r->has_d = 1;
+		return;
+	case OP_CAPPEDTORUS3: {
+		const float scx = a[0], scy = a[1], ra = a[2], rb = a[3];
+		const float px = fabsf(q[0]);
+		const float k = (scy*px > scx*q[1]) ? (px*scx + q[1]*scy) : len2(px, q[1]);
+		r->d = sqrtf(px*px + q[1]*q[1] + q[2]*q[2] + ra*ra - 2.0f*ra*k) - rb;
+		r->has_d = 1;
+		return;
+	}
+	default:
+		break;
+	}
+
+	const int prune = is_min_join(op);
+	for (int c = n[ICIR_FIRST_CHILD]; c >= 0; c = icir_node(ir, c)[ICIR_NEXT_SIBLING]) {
+		// a child can't lower a min() below what it is already at
+		if (prune && r->has_d && bounds_distance(ir, c, q) > r->d) continue;
+		struct res cr;
+		eval_node(ir, c, q, &cr);
+		if (!cr.has_d) continue;
+		if (!r->has_d) {
+			r->d = cr.d;
+			r->has_d = 1;
+		} else {
+			r->d = join_d(op, cr.d, r->d, a);
+		}
+		if (cr.has_m) {
+			if (!r->has_m) {
+				r->m = cr.m;
+				r->has_m = 1;
+			} else if (r->m != cr.m) {
+				r->m = r->d < cr.d ? r->m : cr.m;
+			}
+		}
+	}
+
+	if (op == OP_SCALE2 && r->has_d) r->d *= a[0];
+}
+
+float icir_eval(const struct icir* ir, const float* p, int* out_material)
+{
+	float q[3] = { p[0], p[1], ir->dim == 2 ? 0.0f : p[2] };
+	struct res r;
+	eval_node(ir, 0, q, &r);
+	if (out_material != NULL) *out_material = r.has_m ? r.m : -1;
+	return r.has_d ? r.d : INFINITY;
+}
+
+int icir_march(const struct icir* ir, const float* o, const float* d, float tmax, float* out_t, int* out_material)
+{
+	const float dl = len3(d[0], d[1], d[2]);
+	const float nd[3] = { d[0]/dl, d[1]/dl, d[2]/dl };
+	float t = 0.0f;
+	int material = -1;
+	for (int i = 0; i < 256; i++) {
+		const float pos[3] = { o[0] + t*nd[0], o[1] + t*nd[1], o[2] + t*nd[2] };
+		const float r = icir_eval(ir, pos, &material);
+		if (r < 0.0001f || t > tmax) break;
+		t += r;
+	}
+	if (out_t != NULL) *out_t = t;
+	if (out_material != NULL) *out_material = material;
+	return t < tmax;
+}
+
+int icir_depth(const struct icir* ir)
+{
+	// children and called trees come after a node, so back to front works
+	int* depth = (int*)calloc(ir->n_nodes, sizeof *depth);
+	for (int i = ir->n_nodes-1; i >= 0; i--) {
+		const int32_t* n = icir_node(ir, i);
+		const int op = ir->ops[n[ICIR_TYPE]];
+		if (op == OP_CIRCLE2 || op == OP_SPHERE3 || op == OP_BOX3 || op == OP_CYLINDER3 || op == OP_TORUS3 || op == OP_CAPPEDTORUS3) continue;
+		int d = 0;
+		for (int c = n[ICIR_FIRST_CHILD]; c >= 0; c = icir_node(ir, c)[ICIR_NEXT_SIBLING]) {
+			if (depth[c] > d) d = depth[c];
+		}
+		if (n[ICIR_REF] >= 0 && depth[n[ICIR_REF]] > d) d = depth[n[ICIR_REF]];
+		depth[i] = 1 + d;
+	}
+	const int d = depth[0];
+	free(depth);
+	return d;
+}
+
+size_t icir_glsl_buffer_size(const struct icir* ir)
+{
+	return (1 + (size_t)ir->n_nodes*(ICIR_NODE_SIZE+6)) * sizeof(int32_t);
+}
+
+void icir_glsl_buffer(const struct icir* ir, void* out)
+{
+	int32_t* p = (int32_t*)out;
+	*(p++) = ir->n_nodes;
+	for (int i = 0; i < ir->n_nodes; i++) {
+		const int32_t* n = icir_node(ir, i);
+		memcpy(p, n, ICIR_NODE_SIZE*sizeof *p);
+		p[ICIR_TYPE] = ir->ops[n[ICIR_TYPE]];
+		p += ICIR_NODE_SIZE;
+	}
+	memcpy(p, ir->bounds, (size_t)ir->n_nodes*6*sizeof *p);
+}
+
+// mirrors eval_node(), with an explicit stack of ICIR_GLSL_MAX_DEPTH frames
+// in place of recursion. leaves are evaluated straight into their parent's
+// frame. materials are returned as IDs, like iclib's map_dm() does; the
+// IR's material table is the view's palette
+static const char glsl_body[] =
+	"layout (std430, binding = 0) readonly buffer Params {\n"
+	"	float u_params[];\n"
+	"};\n"
+	"\n"
+	"// n_nodes, nodes (type is the op) and bounds; see icir_glsl_buffer()\n"
+	"layout (std430, binding = 1) readonly buffer IR {\n"
+	"	int u_ir[];\n"
+	"};\n"
+	"\n"
+	"int ir_node(int i, int f) { return u_ir[1 + i*ICIR_NODE_SIZE + f]; }\n"
+	"float ir_param(int i) { return u_params[i]; }\n"
+	"float ir_float(int i) { return intBitsToFloat(u_ir[i]); }\n"
+	"\n"
+	"float ir_bounds_distance(int i, vec3 q)\n"
+	"{\n"
+	"	int b = 1 + u_ir[0]*ICIR_NODE_SIZE + i*6;\n"
+	"	vec3 lo = vec3(ir_float(b), ir_float(b+1), ir_float(b+2));\n"
+	"	vec3 hi = vec3(ir_float(b+3), ir_float(b+4), ir_float(b+5));\n"
+	"	return length(max(max(lo-q, q-hi), 0.0));\n"
+	"}\n"
+	"\n"
+
+	"bool ir_is_leaf(int op)\n"
+	"{\n"
+	"	return op == OP_CIRCLE2 || op == OP_SPHERE3 || op == OP_BOX3 || op == OP_CYLINDER3 || op == OP_TORUS3 || op == OP_CAPPEDTORUS3;\n"
+	"}\n"
+	"\n"
+	"bool ir_is_min_join(int op)\n"
+	"{\n"
+	"	return !(op == OP_SUBTRACT || op == OP_INTERSECT || op == OP_SMOOTH_UNION || op == OP_SMOOTH_SUBTRACT || op == OP_SMOOTH_INTERSECT);\n"
+	"}\n"
+	"\n"
+	"float ir_leaf(int op, int a, vec3 q)\n"
+	"{\n"
+	"	if (op == OP_CIRCLE2) return length(q.xy) - ir_param(a);\n"
+	"	if (op == OP_SPHERE3) return length(q) - ir_param(a);\n"
+	"	if (op == OP_BOX3) {\n"
+	"		vec3 e = abs(q) - vec3(ir_param(a), ir_param(a+1), ir_param(a+2));\n"
+	"		return length(max(e,0.0)) + min(max(e.x,max(e.y,e.z)),0.0);\n"
+	"	}\n"
+	"	if (op == OP_CYLINDER3) return length(q.xz) - ir_param(a);\n"
+	"	if (op == OP_TORUS3) return length(vec2(length(q.xz)-ir_param(a), q.y)) - ir_param(a+1);\n"
+	"	// OP_CAPPEDTORUS3\n"
+	"	vec2 sc = vec2(ir_param(a), ir_param(a+1));\n"
+	"	float ra = ir_param(a+2);\n"
+	"	float rb = ir_param(a+3);\n"
+	"	q.x = abs(q.x);\n"
+	"	float k = (sc.y*q.x>sc.x*q.y) ? dot(q.xy,sc) : length(q.xy);\n"
+	"	return sqrt(dot(q,q) + ra*ra - 2.0*ra*k) - rb;\n"
+	"}\n"
+	"\n"
+	"// joins child distance d0 (material m0, or -1) into a frame\n"
+	"void ir_join(int op, int a, float d0, int m0, inout float d, inout bool has_d, inout int m)\n"
+	"{\n"
+	"	if (!has_d) {\n"
+	"		d = d0;\n"
+	"		has_d = true;\n"
+	"	} else if (op == OP_SUBTRACT) {\n"
+	"		d = max(-d0, d);\n"
+	"	} else if (op == OP_INTERSECT) {\n"
+	"		d = max(d0, d);\n"
+	"	} else if (op == OP_SMOOTH_UNION) {\n"
+	"		float k = ir_param(a);\n"
+	"		float h = clamp(0.5 + 0.5*(d-d0)/k, 0.0, 1.0);\n"
+	"		d = mix(d, d0, h) - k*h*(1.0-h);\n"
+	"	} else if (op == OP_SMOOTH_SUBTRACT) {\n"
+	"		float k = ir_param(a);\n"
+	"		float h = clamp(0.5 - 0.5*(d+d0)/k, 0.0, 1.0);\n"
+	"		d = mix(d, -d0, h) + k*h*(1.0-h);\n"
+	"	} else if (op == OP_SMOOTH_INTERSECT) {\n"
+	"		float k = ir_param(a);\n"
+	"		float h = clamp(0.5 - 0.5*(d-d0)/k, 0.0, 1.0);\n"
+	"		d = mix(d, d0, h) + k*h*(1.0-h);\n"
+	"	} else {\n"
+	"		d = min(d0, d);\n"
+	"	}\n"
+	"	if (m0 >= 0) m = (m < 0 || (m != m0 && d >= d0)) ? m0 : m;\n"
+	"}\n"
+	"\n"
+	"// the frames are packed so the stack is two arrays (which matters for drivers\n"
+	"// keeping it in registers): st_i is node, next child to visit (or -1),\n"
+	"// material (or -1) and whether d is set; st_f is the point and d\n"
+	"float ir_map(ICIR_VEC p, const bool with_material, out int out_material)\n"
+	"{\n"
+	"	ivec4 st_i[ICIR_GLSL_MAX_DEPTH];\n"
+	"	vec4 st_f[ICIR_GLSL_MAX_DEPTH];\n"
+	"	int sp = 0;\n"
+	"#if ICIR_DIM == 3\n"
+	"	st_f[0] = vec4(p, 0.0);\n"
+	"#else\n"
+	"	st_f[0] = vec4(p, 0.0, 0.0);\n"
+	"#endif\n"
+	"	st_i[0] = ivec4(0, ir_node(0, ICIR_FIRST_CHILD), -1, 0);\n"
+	"	float d;\n"
+	"	while (true) {\n"
+	"		ivec4 fi = st_i[sp];\n"
+	"		vec4 ff = st_f[sp];\n"
+	"		int n = fi.x;\n"
+	"		int op = ir_node(n, ICIR_TYPE);\n"
+	"		int c = fi.y;\n"
+	"		bool has_d = fi.w != 0;\n"
+	"		// a child can't lower a min() below what it is already at\n"
+	"		if (ir_is_min_join(op) && has_d) {\n"
+	"			while (c >= 0 && ir_bounds_distance(c, ff.xyz) > ff.w) c = ir_node(c, ICIR_NEXT_SIBLING);\n"
+	"		}\n"
+	"		if (c >= 0) {\n"
+	"			fi.y = op == OP_SUBSCENE ? -1 : ir_node(c, ICIR_NEXT_SIBLING);\n"
+	"			int cop = ir_node(c, ICIR_TYPE);\n"
+	"			int ca = ir_node(c, ICIR_PARAM0);\n"
+	"			if (ir_is_leaf(cop)) {\n"
+	"				ir_join(op, ir_node(n, ICIR_PARAM0), ir_leaf(cop, ca, ff.xyz), -1, ff.w, has_d, fi.z);\n"
+	"				st_i[sp] = ivec4(fi.xyz, has_d ? 1 : 0);\n"
+	"				st_f[sp] = ff;\n"
+	"				continue;\n"
+	"			}\n"
+	"			st_i[sp] = fi;\n"
+	"			if (sp+1 == ICIR_GLSL_MAX_DEPTH) continue; // see icir_depth()\n"
+	"			vec3 q = ff.xyz;\n"
+	"			if (cop == OP_TRANSLATE2) q.xy += vec2(ir_param(ca), ir_param(ca+1));\n"
+	"			if (cop == OP_SCALE2) q.xy /= ir_param(ca);\n"
+	"			if (cop == OP_TRANSLATE3) q += vec3(ir_param(ca), ir_param(ca+1), ir_param(ca+2));\n"
+	"			sp++;\n"
+	"			st_i[sp] = ivec4(c, cop == OP_SUBSCENE ? ir_node(c, ICIR_REF) : ir_node(c, ICIR_FIRST_CHILD), with_material && cop == OP_MATERIAL ? ir_node(c, ICIR_MATERIAL) : -1, 0);\n"
+	"			st_f[sp] = vec4(q, 0.0);\n"
+	"			continue;\n"
+	"		}\n"
+	"		d = has_d ? ff.w : 1e30;\n"
+	"		if (op == OP_SCALE2) d *= ir_param(ir_node(n, ICIR_PARAM0));\n"
+	"		if (sp == 0) break;\n"
+	"		sp--;\n"
+	"		if (has_d) {\n"
+	"			ivec4 pi = st_i[sp];\n"
+	"			vec4 pf = st_f[sp];\n"
+	"			bool parent_has_d = pi.w != 0;\n"
+	"			ir_join(ir_node(pi.x, ICIR_TYPE), ir_node(pi.x, ICIR_PARAM0), d, fi.z, pf.w, parent_has_d, pi.z);\n"
+	"			st_i[sp] = ivec4(pi.xyz, parent_has_d ? 1 : 0);\n"
+	"			st_f[sp] = pf;\n"
+	"		}\n"
+	"	}\n"
+	"	out_material = st_i[0].z;\n"
+	"	return d;\n"
+	"}\n"
+	"\n"
+	"// without materials no frame gets one, and ir_join() never selects\n"
+	"float map_d(ICIR_VEC p) { int m; return ir_map(p, false, m); }\n"
+	"float map_dm(ICIR_VEC p, out int out_material) { return ir_map(p, true, out_material); }\n";
+
+const char* icir_glsl(int dim)
+{
+	static char* glsl[4];
+	if (dim < 2 || dim > 3) return NULL;
+	if (glsl[dim] != NULL) return glsl[dim];
+	const int n_ops = sizeof(op_names)/sizeof(op_names[0]);
+	const size_t size = sizeof glsl_body + 1024 + n_ops*64;
+	char* out = (char*)malloc(size);
+	char* p = out;
+	char* p1 = out + size;
+	p += snprintf(p, p1-p,
+		"#define ICIR_DIM %d\n"
+		"#define ICIR_VEC vec%d\n"
+		"const int ICIR_GLSL_MAX_DEPTH = %d;\n"
+		"const int ICIR_NODE_SIZE = %d;\n"
+		"const int ICIR_TYPE = %d;\n"
+		"const int ICIR_FIRST_CHILD = %d;\n"
+		"const int ICIR_NEXT_SIBLING = %d;\n"
+		"const int ICIR_PARAM0 = %d;\n"
+		"const int ICIR_MATERIAL = %d;\n"
+		"const int ICIR_REF = %d;\n",
+		dim, dim, ICIR_GLSL_MAX_DEPTH, ICIR_NODE_SIZE,
+		ICIR_TYPE, ICIR_FIRST_CHILD, ICIR_NEXT_SIBLING, ICIR_PARAM0, ICIR_MATERIAL, ICIR_REF);
+	for (int op = 1; op < n_ops; op++) {
+		p += snprintf(p, p1-p, "const int OP_");
+		for (const char* c = op_names[op]; *c; c++) *(p++) = toupper(*c);
+		p += snprintf(p, p1-p, " = %d;\n", op);
+	}
+	p += snprintf(p, p1-p, "\n%s", glsl_body);
+	glsl[dim] = out;
+	return out;
+}
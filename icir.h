@@ -0,0 +1,98 @@
+#ifndef ICIR_H
+
+// reader and CPU evaluator for the binary scene IR that iclib returns next to
+// the GLSL source of a view (_ViewGen.ir; the layout is documented at
+// _IRWriter in iclib.py). icir_open() doesn't copy; the IR must outlive it.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ICIR_MAGIC (0x52494349)
+#define ICIR_VERSION (1)
+
+// node record fields
+enum {
+	ICIR_TYPE = 0,
+	ICIR_PARENT,
+	ICIR_FIRST_CHILD,
+	ICIR_NEXT_SIBLING,
+	ICIR_PARAM0,
+	ICIR_N_PARAMS,
+	ICIR_MATERIAL,
+	ICIR_REF,
+	ICIR_NODE_SIZE
+};
+
+struct icir {
+	int dim;
+	int n_nodes;
+	int n_params;
+	int n_materials;
+	int n_types;
+	const int32_t* nodes; // n_nodes*ICIR_NODE_SIZE
+	const float* bounds; // n_nodes*6; x0,y0,z0,x1,y1,z1
+	const float* params;
+	const float* materials; // n_materials*6; albedo, emission
+	const char** type_names; // n_types
+	uint8_t* ops; // per type; what icir_eval() makes of it
+	int n_unknown_types; // types icir_eval() treats as plain unions
+};
+
+// returns 0 on success
+int icir_open(struct icir* ir, const void* data, size_t size);
+void icir_close(struct icir* ir);
+
+static inline const int32_t* icir_node(const struct icir* ir, int i)
+{
+	return &ir->nodes[i*ICIR_NODE_SIZE];
+}
+
+static inline const char* icir_type_name(const struct icir* ir, int i)
+{
+	return ir->type_names[icir_node(ir, i)[ICIR_TYPE]];
+}
+
+// what differs between two IRs of the same view (icir_diff() bits). bounds
+// follow from the params and aren't compared on their own
+enum {
+	ICIR_CHANGED_PARAMS    = 1<<0, // parameter values; same tree
+	ICIR_CHANGED_MATERIALS = 1<<1, // material table; same tree
+	ICIR_CHANGED_STRUCTURE = 1<<2, // anything else; implies nothing about the rest
+};
+
+int icir_diff(const struct icir* a, const struct icir* b);
+
+// distance at p (z is ignored in 2D), as the view's map_dm() computes it; the
+// material index (or -1) goes to out_material if not NULL
+float icir_eval(const struct icir* ir, const float* p, int* out_material);
+
+// sphere traces like the 3D template's march3d(); returns 1 on a hit
+int icir_march(const struct icir* ir, const float* o, const float* d, float tmax, float* out_t, int* out_material);
+
+// frames needed to evaluate the IR, i.e. the number of non-leaf nodes on
+// the deepest path (through called trees). icir_glsl() has room for
+// ICIR_GLSL_MAX_DEPTH
+int icir_depth(const struct icir* ir);
+
+#define ICIR_GLSL_MAX_DEPTH (48)
+
+// GLSL map_d() and map_dm() for the given dimension that interpret the IR
+// instead of having the scene compiled in. they read the params from binding
+// 0 (like iclib.bulk_params views) and what icir_glsl_buffer() writes from
+// binding 1; map_dm() returns material IDs into the view's palette, i.e. the
+// IR's material table. like icir_eval() they treat unknown types as plain
+// unions
+const char* icir_glsl(int dim);
+size_t icir_glsl_buffer_size(const struct icir* ir);
+void icir_glsl_buffer(const struct icir* ir, void* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ICIR_H
+#endif
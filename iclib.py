@@ -1,5 +1,6 @@
 import os, sys
-import gc
+import gc, hashlib, marshal, math, struct
+from array import array
 
 def _untab(txt):
 	while len(txt) > 0 and txt[0] == "\n": txt = txt[1:]
@@ -27,18 +28,54 @@ def watchlist():
 	return fs
 #print(watchlist())
 
+print_source = True # dump generated GLSL to stdout on each view call
+
+# views with at least this many parameters (floats) read them from a buffer
+# that iced.cpp fills from the IR, instead of from GLSL literals. that spares
+# formatting and parsing them, and a reload that only changes their values
+# uploads them instead of recompiling. @subscene bodies always use literals
+bulk_params = 256
+
 _views = []
 _viewset = set()
 def viewlist(): return _views
 
+# @subscene cache; survives soft reloads (importlib.reload() re-runs this file
+# in the same module dict), see subscene() below
+_memo_cache = globals().get("_memo_cache", {})
+_memo_digests = globals().get("_memo_digests", {})
+_memo_recorders = []
+_memo_stats = [0,0] # hits, misses
+
 _active_codegen = None
 _active_mset = None
+# a view call first runs the view constructor, which only builds a tree of
+# nodes (construction; _Node.exec() and the push()/pop()/top() stack below).
+# the tree is then walked twice: once to serialize it into the binary IR
+# returned to iced.cpp (see _IRWriter), and once to emit GLSL (emission;
+# _Node.emit() and the rest of _Codegen)
 class _Codegen:
-	def __init__(self):
+	def __init__(self, dim):
+		self.dim = dim
 		self.define_set = set()
 		self.defines = []
 		self.fns = []
 		self.onceset = set()
+		self.stack = []
+		self.bulk = False # args are read from u_params[], see bulk_params
+		self.params = None # the IR's params, see literal()
+		self.literals = None
+		# materials are carried through map_dm() as integer IDs into the
+		# palette (see MaterialSet.mkpalette()); with material False they're
+		# left out, as in map_d()
+		self.material = True
+		self.material_index = None # the IR's material table index, see material_id()
+		self.mlocal = None
+		# emitted lines per node type (the type emitting them; joins count
+		# against the joining scope) and constants, for _View.stats()
+		self.owner = "root"
+		self.line_counts = {}
+		self.n_constants = 0
 
 	def once(self, x):
 		if x in self.onceset:
@@ -70,37 +107,83 @@ class _Codegen:
 	def enter(self):
 		self.ident_serials = {}
 		self.const_map = {}
-		self.stack = []
 		self.lines = []
 
-	def leave(self):
-		assert len(self.stack) == 1, "expected stack to contain only root node"
-		top = _cg().top()
-		if hasattr(top, "mvar"):
-			self.line("\tout_material = %s;" % top.mvar)
-		if hasattr(top, "dvar"):
-			self.line("\treturn %s;" % top.dvar)
+	def leave(self, root):
+		if self.material:
+			self.line("\tout_material = %s;" % getattr(root, "mvar", "-1"))
+		if hasattr(root, "dvar"):
+			self.line("\treturn %s;" % root.dvar)
 		self.line("}")
 		self.pushfn("\n".join(self.lines))
 		self.lines = None
-		self.stack = None
 		self.const_map = None
 		self.ident_serials = None
 
-	def enter_map(self, fn, dim):
+	def emit_map(self, fn, root, material):
 		self.enter()
-		pvar = self.ident("p")
-		mxtra = ""
-		mxtra = ", out Material out_material"
-		self.line("float %s(vec%d %s%s)" % (fn, dim, pvar, mxtra))
+		self.material = material
+		root.reset()
+		root.pvar = self.ident("p")
+		mxtra = ", out int out_material" if material else ""
+		self.line("float %s(vec%d %s%s)" % (fn, root.dim, root.pvar, mxtra))
 		self.line("{")
-		self.push(_RootNode(pvar, dim))
+		root.emit_children()
+		self.leave(root)
+		self.material = True
+
+	def emit_subscene(self, fn, root, material):
+		# emits a sub-scene as a function of its own, in the middle of
+		# emitting another. returns (source, materials, counts); source is
+		# None if the sub-scene has no geometry. materials are the types
+		# whose IDs it returns, indexed by the ID; IDs are local to the
+		# sub-scene because its source is shared between views (see
+		# _SubsceneNode.emit()). counts are its line counts and number of
+		# constants, which count() adds to each view using it
+		saved = (self.ident_serials, self.const_map, self.lines, self.bulk, self.owner, self.line_counts, self.n_constants, self.material, self.mlocal)
+		self.enter()
+		self.bulk = False # shared between views; indices are per view
+		self.owner = "root"
+		self.line_counts = {}
+		self.n_constants = 0
+		self.material = material
+		self.mlocal = []
+		root.reset()
+		root.pvar = self.ident("p")
+		root.emit_children()
+		src = None
+		has_m = hasattr(root, "mvar")
+		if hasattr(root, "dvar"):
+			lines = ["float %s(vec%d %s%s)" % (fn, root.dim, root.pvar, ", out int out_material" if has_m else ""), "{"]
+			lines += self.lines
+			if has_m: lines.append("\tout_material = %s;" % root.mvar)
+			lines.append("\treturn %s;" % root.dvar)
+			lines.append("}")
+			src = "\n".join(lines)
+		materials = self.mlocal if has_m else []
+		counts = (self.line_counts, self.n_constants)
+		(self.ident_serials, self.const_map, self.lines, self.bulk, self.owner, self.line_counts, self.n_constants, self.material, self.mlocal) = saved
+		return src, materials, counts
+
+	def material_id(self, t):
+		# ID of material type t in what's being emitted: its index in the IR's
+		# material table in a view, local in a sub-scene
+		t = _memo_resolve(t)
+		if self.mlocal is None: return self.material_index[t]
+		if t not in self.mlocal: self.mlocal.append(t)
+		return self.mlocal.index(t)
+
+	def count(self, counts):
+		(line_counts, n_constants) = counts
+		for k,n in line_counts.items(): self.line_counts[k] = self.line_counts.get(k, 0) + n
+		self.n_constants += n_constants
 
 	def source(self):
 		return ("\n".join(self.defines)) + "\n\n" + ("\n".join(self.fns))
 
 	def line(self, line):
 		self.lines.append(line)
+		self.line_counts[self.owner] = self.line_counts.get(self.owner, 0) + 1
 
 	def ident(self, prefix):
 		if prefix not in self.ident_serials:
@@ -108,10 +191,17 @@ class _Codegen:
 		self.ident_serials[prefix] += 1
 		return "%s%d" % (prefix, self.ident_serials[prefix])
 
+	def literal(self, i):
+		# literal for param i of the IR. bulk views only format the few
+		# that @subscene bodies need, one by one
+		if self.literals is None: return _float_literal(self.params[i])
+		return self.literals[i]
+
 	def constant(self, typ, literal):
 		if literal not in self.const_map:
 			i = self.ident("c")
 			self.line("\t%s %s = %s;" % (typ, i, literal))
+			self.n_constants += 1
 			self.const_map[literal] = i
 		return self.const_map[literal]
 
@@ -133,8 +223,14 @@ def _wpp_flush():
 	_wpp_todo = []
 
 class _ViewGen:
-	def __init__(self, source):
+	def __init__(self, source, ir, fallback, stats):
 		self.source = source
+		self.ir = ir # bytes; see _IRWriter
+		# what iced.cpp compiles instead of source when that's over budget:
+		# source without map_d()/map_dm() and everything only they use. those
+		# then come from icir_glsl(), which interprets the IR
+		self.fallback = fallback
+		self.stats = stats # see _View.stats()
 
 class MaterialSet:
 	ff = [
@@ -153,26 +249,30 @@ class MaterialSet:
 			if nam in self.z: fields += ("\t%s %s;\n" % (typ, nam))
 		return "struct Material {\n" + fields + "};\n"
 
-	def format(self, material):
-		s = "Material("
-		first = True
-		for (nam,typ) in self.ff:
+	def mkpalette(self):
+		# material values live in a buffer that iced.cpp fills from the IR's
+		# material table, a vec4 per field in ff order; map_dm() only
+		# returns an index into it (or -1), and palette() looks the material up once
+		# it's needed
+		n = len(self.ff)
+		args = []
+		for i,(nam,typ) in enumerate(self.ff):
 			if not nam in self.z: continue
-			a = None
-			if hasattr(material, nam):
-				a = getattr(material, nam)
-
-			if typ == "vec3":
-				x = "vec3(0.0,0.0,0.0)"
-				if a is not None:
-					x = "vec3(%f,%f,%f)" % a
-				if not first: s += ", "
-				s += x
-				first = False
-			else:
-				assert False, "no handler for typ=%s" % typ
-		s += ")"
-		return s
+			assert typ == "vec3", "no handler for typ=%s" % typ
+			args.append("u_palette[%d*id+%d].xyz" % (n, i))
+		zero = ", ".join("%s(0.0)" % typ for (nam,typ) in self.ff if nam in self.z)
+		return _untab(
+		"""
+		layout (std430, binding = 2) readonly buffer Palette {
+			vec4 u_palette[];
+		};
+
+		Material palette(int id)
+		{
+			if (id < 0) return Material(%s);
+			return Material(%s);
+		}
+		""") % (zero, ", ".join(args))
 
 class _View:
 	def __init__(self, dim, name, ctor):
@@ -183,7 +283,7 @@ class _View:
 	def __call__(self):
 		_wpp_flush()
 		global _active_codegen, _active_mset
-		_active_codegen = _Codegen()
+		_active_codegen = _Codegen(self.dim)
 		if self.dim == 2:
 			_active_mset = MaterialSet(set(("albedo",)))
 		elif self.dim == 3:
@@ -191,105 +291,290 @@ class _View:
 		else:
 			assert False, "unreachable"
 
-		if not _active_mset.empty():
-			_active_codegen.define("Material", _active_mset.mktype())
-		_active_codegen.enter_map("map", self.dim)
+		root = _RootNode(self.dim)
+		_active_codegen.push(root)
 		self.ctor()
-		_active_codegen.leave()
+		assert _active_codegen.stack == [root], "unbalanced scopes"
+
+		irw = _IRWriter(self.dim)
+		ir = irw.write(root)
+		_active_codegen.params = irw.params
+		_active_codegen.material_index = irw.material_index
+
+		if not _active_mset.empty():
+			_active_codegen.define("Material", _active_mset.mktype() + "\n" + _active_mset.mkpalette())
+		if len(irw.params) >= bulk_params:
+			_active_codegen.define("u_params", _untab(
+			"""
+			layout (std430, binding = 0) readonly buffer Params {
+				float u_params[];
+			};
+			float P1(int i) { return u_params[i]; }
+			vec2 P2(int i) { return vec2(u_params[i], u_params[i+1]); }
+			vec3 P3(int i) { return vec3(u_params[i], u_params[i+1], u_params[i+2]); }
+			vec4 P4(int i) { return vec4(u_params[i], u_params[i+1], u_params[i+2], u_params[i+3]); }
+			"""
+			))
+			_active_codegen.bulk = True
+		else:
+			_active_codegen.literals = _float_literals(irw.params)
+		# the templates march, take normals and cast shadow rays with the
+		# distance-only variant, and only ask for the material at the hit
+		_active_codegen.emit_map("map_d", root, False)
+		_active_codegen.emit_map("map_dm", root, True)
 
 		if self.dim == 2:
-			_active_codegen.pushfn(_untab(
+			template = (_untab(
 			"""
-			vec3 render2d(vec2 p)
+			// isolines of the distance field, anti-aliased. a line is ~1.5
+			// pixels wide; px is the pixel size in world units
+			float isoline(float d, float spacing, float px)
 			{
-				Material material;
-				float d = map(p, material);
-				float m = d > 0.0 ? min(1.0, 0.6+d*0.1) : 1.0;
+				float e = abs(fract(d/spacing + 0.5) - 0.5) * spacing / px;
+				return 1.0 - smoothstep(0.25, 1.25, e);
+			}
+
+			// px is the world size of the pixel (or sample). map_d() is
+			// 1-Lipschitz, so d changes by at most px across it; that filters
+			// the edge and the isolines without taking derivatives of d
+			vec3 render2d(float px, vec2 p, out float depth)
+			{
+				float d = map_d(p);
+				depth = d;
+				float cover = clamp(0.5 - d/px, 0.0, 1.0);
+				Material material = palette(-1);
+				if (cover > 0.0) {
+					int id;
+					map_dm(p, id);
+					material = palette(id);
+				}
+
+				// isolines every power of two that puts them 8-16 pixels
+				// apart, fading out as they get closer, over every other
+				// one at full strength; within 32 of the wider spacings of
+				// the surface only
+				float lod = log2(px*16.0);
+				float spacing = exp2(floor(lod));
+				float range = 64.0*spacing;
+				float iso = 0.0;
+				if (abs(d) < range) {
+					iso = max(isoline(d, 2.0*spacing, px), (1.0 - fract(lod)) * isoline(d, spacing, px));
+					iso *= 1.0 - abs(d)/range;
+				}
+
+				float m = min(1.0, 0.6+max(d, 0.0)*0.1);
 				float m2 = max(0.0, 1.0 - abs(d*0.03));
 				m2 = m2*m2*m2;
-				vec3 c = (d < 0.0) ? material.albedo : vec3(0.2*m2, 0.3*m2, 0.4);
-				vec3 a0 = (d < 0.0) ? vec3(-0.0, -0.1, -0.2) : vec3(0.02, -0.03, -0.03);
-				float cc = cos(d*3.0);
-				cc = cc*cc*cc*cc*cc*cc*cc*cc*cc;
-				c += cc * a0;
-				return m*c;
+				vec3 outside = m*(vec3(0.2*m2, 0.3*m2, 0.4) + iso*vec3(0.06, 0.08, 0.1));
+				vec3 inside = material.albedo * (1.0 - 0.25*iso);
+				return mix(outside, inside, cover);
 			}
 			"""
 			))
 		elif self.dim == 3:
-			_active_codegen.pushfn(_untab(
+			template = (_untab(
 			"""
+			// what this pixel cost so far, for the cost heatmaps (u_shading
+			// >= 3): map_d()/map_dm() calls made by the functions below, and
+			// the shadow march steps among them
+			int n_map_calls = 0;
+			int n_shadow_steps = 0;
+
+			// every map_d() call site inlines the whole scene, so the
+			// tetrahedron taps (1,-1,-1), (-1,-1,1), (-1,1,-1), (1,1,1) are
+			// a loop rather than four calls
 			vec3 calc_normal(vec3 p)
 			{
 				const float h = 0.001;
-				const vec2 k = vec2(1,-1);
-				Material _;
-				return normalize(
-					k.xyy * map(p + k.xyy*h, _) +
-					k.yyx * map(p + k.yyx*h, _) +
-					k.yxy * map(p + k.yxy*h, _) +
-					k.xxx * map(p + k.xxx*h, _) );
+				vec3 n = vec3(0.0);
+				for (int i = 0; i < 4; i++) {
+					vec3 k = 2.0*vec3(((i+3)>>1)&1, (i>>1)&1, i&1) - 1.0;
+					n_map_calls++;
+					n += k * map_d(p + k*h);
+				}
+				return normalize(n);
 			}
 
-			float pointlight(vec3 o, vec3 l)
+			// lighting comes from uniforms set per view window (struct
+			// lighting in iced.cpp). shadow and AO marches stop at their
+			// step budget, or earlier once the result is saturated
+			layout (location = 10) uniform int u_n_lights;
+			layout (location = 11) uniform int u_shadow_steps;
+			layout (location = 12) uniform float u_penumbra;
+			layout (location = 13) uniform int u_ao_taps;
+			layout (location = 14) uniform float u_ao_step;
+			layout (location = 15) uniform float u_ambient;
+			layout (location = 16) uniform vec3 u_light_pos[4];
+			layout (location = 20) uniform vec3 u_light_color[4];
+
+			// penumbra soft shadow towards l; 0 is fully shadowed
+			float softshadow(vec3 o, vec3 l)
 			{
-				vec3 d = normalize(l-o);
-				vec3 o2 = o + d*0.01;
-				vec3 pos;
-				float t = 0.0;
-				for (int i = 0; i < 32; i++) {
-					pos = o2 + t*d;
-					Material material;
-					float r = map(pos, material);
-					r = min(r, length(l-pos));
-					if (r<0.001) break;
-					t += r;
+				vec3 d = l - o;
+				float tmax = length(d);
+				d /= tmax;
+				float res = 1.0;
+				float t = 0.01;
+				for (int i = 0; i < u_shadow_steps && t < tmax; i++) {
+					n_map_calls++;
+					n_shadow_steps++;
+					float h = map_d(o + t*d);
+					res = min(res, u_penumbra*h/t);
+					if (res < 0.001) break;
+					t += max(h, 0.002);
 				}
-				if (length(l-pos)<0.01) {
-					float r = length(l-o);
-					r = r*r;
-					return 30.0 / r;
-				} else {
-					return 0.0;
+				return res < 0.001 ? 0.0 : res;
+			}
+
+			// few-tap SDF ambient occlusion along the normal; 1 is unoccluded
+			float ambient_occlusion(vec3 p, vec3 n)
+			{
+				float occ = 0.0;
+				float w = 1.0;
+				for (int i = 1; i <= u_ao_taps; i++) {
+					float h = u_ao_step*float(i);
+					n_map_calls++;
+					occ += w*max(0.0, h - map_d(p + h*n))/h;
+					if (occ >= 1.0) break;
+					w *= 0.5;
 				}
+				return max(0.0, 1.0 - occ);
 			}
 
-			vec3 render3d(vec3 o, vec3 d)
+			vec3 shade(vec3 pos, vec3 normal, Material material)
 			{
-				vec3 nd = normalize(d);
+				float ao = u_ao_taps > 0 ? ambient_occlusion(pos, normal) : 1.0;
+				vec3 li = vec3(u_ambient*ao);
+				for (int i = 0; i < u_n_lights; i++) {
+					vec3 l = u_light_pos[i] - pos;
+					float r2 = dot(l, l);
+					float ndl = dot(normal, l) * inversesqrt(r2);
+					if (ndl <= 0.0) continue;
+					float s = u_shadow_steps > 0 ? softshadow(pos, u_light_pos[i]) : 1.0;
+					if (s <= 0.0) continue;
+					li += u_light_color[i] * (s*ndl/r2);
+				}
+				return material.albedo * li + material.emission;
+			}
+
+			// the primary march kernel (struct march in iced.cpp); u_march
+			// selects plain (0) or over-relaxed (1) sphere tracing. a hit
+			// is closer than the larger of 0.0001 and the pixel footprint
+			// u_pixel_cone*t; 0 cone is a fixed epsilon
+			layout (location = 28) uniform int u_march;
+			layout (location = 29) uniform float u_relaxation;
+			layout (location = 30) uniform float u_far;
+			layout (location = 31) uniform float u_pixel_cone;
+			layout (location = 32) uniform int u_march_steps;
+
+			// returns the hit distance, or -1.0 on a miss, and the number of
+			// steps taken
+			float march3d(vec3 o, vec3 nd, out int steps)
+			{
+				float omega = u_march == 1 ? u_relaxation : 1.0;
 				float t = 0.0;
-				Material material;
-				const float tmax = 100.0;
-				for (int i = 0; i < 256; i++) {
+				float prev_r = 0.0;
+				float step = 0.0;
+				int i;
+				for (i = 0; i < u_march_steps; i++) {
+					n_map_calls++;
 					vec3 pos = o + t*nd;
-					float r = map(pos, material);
-					if (r<0.0001 || t>tmax) break;
-					t += r;
+					float r = map_d(pos);
+					if (omega > 1.0 && abs(r) + prev_r < step) {
+						// the unbounding spheres of the last two points
+						// don't overlap, so the over-relaxed step may have
+						// skipped a surface; take it back and go on plain
+						step -= omega*step;
+						omega = 1.0;
+					} else {
+						if (r < max(0.0001, u_pixel_cone*t) || t > u_far) break;
+						step = omega*r;
+					}
+					prev_r = abs(r);
+					t += step;
 				}
+				steps = i;
+				return t < u_far ? t : -1.0;
+			}
 
-				if (t >= tmax) return vec3(0.0, 0.0, 0.0);
-
-				vec3 pos = o + t*nd;
-				vec3 normal = calc_normal(pos);
-
-				vec3 l0 = o + vec3(0.0, 0.0, -4.0);
+			// what iced.cpp's geometry pass stores per pixel: hit distance,
+			// normal, material ID, step count and n_map_calls. its render3d()
+			// (FRAGMENT_MAIN_3D) calls this and shade_pixel() once each,
+			// whatever the pass, so that the scene is inlined only so often
+			float geometry3d(vec3 o, vec3 nd, out vec3 normal, out int id, out int steps)
+			{
+				float t = march3d(o, nd, steps);
+				normal = vec3(0.0);
+				id = -1;
+				if (t >= 0.0) {
+					vec3 pos = o + t*nd;
+					n_map_calls++;
+					map_dm(pos, id);
+					normal = calc_normal(pos);
+				}
+				return t;
+			}
 
-				float li = pointlight(pos, l0);
-				li *= dot(normal, normalize(l0-pos));
-				li += 0.15;
+			// shading pass output; u_shading selects lit (0) or a debug view:
+			// normals (1), distance (2), or a heatmap of the primary march
+			// steps (3), map calls (4) or shadow steps (5) that reaches white
+			// at u_heat_max. map_calls is what the geometry pass spent
+			layout (location = 24) uniform int u_shading;
+			layout (location = 25) uniform float u_exposure;
+			layout (location = 26) uniform bool u_tonemap;
+			layout (location = 27) uniform int u_heat_max;
 
-				return material.albedo * li + material.emission;
+			vec3 shade_pixel(vec3 o, vec3 nd, float t, vec3 normal, int id, int steps, int map_calls)
+			{
+				n_map_calls = map_calls;
+				n_shadow_steps = 0;
+				vec3 c = vec3(0.0);
+				if (t >= 0.0 && (u_shading == 0 || u_shading >= 3)) {
+					c = u_exposure * shade(o + t*nd, normal, palette(id));
+				}
+				if (u_shading >= 3) {
+					int n = u_shading == 3 ? steps : u_shading == 4 ? n_map_calls : n_shadow_steps;
+					float x = 3.0*float(n)/float(u_heat_max);
+					return clamp(vec3(x, x-1.0, x-2.0), 0.0, 1.0);
+				}
+				if (t < 0.0) return vec3(0.0, 0.0, 0.0);
+				if (u_shading == 1) return normal*0.5 + 0.5;
+				if (u_shading == 2) return vec3(1.0/(1.0 + 0.1*t));
+				return u_tonemap ? c/(1.0 + c) : c;
 			}
 			"""
 			))
 		else:
 			assert False, "unreachable"
 
+		_active_codegen.pushfn(template)
+
 		source = _active_codegen.source()
-		print(source)
+		if print_source: print(source)
+		fallback = "\n".join((
+			_active_mset.mktype(),
+			_active_mset.mkpalette(),
+			"float map_d(vec%d p);" % self.dim,
+			"float map_dm(vec%d p, out int out_material);\n" % self.dim,
+			template))
+		stats = self.stats(source, irw, _active_codegen)
 		_active_codegen = None
 		_active_mset = None
-		return _ViewGen(source)
+		return _ViewGen(source, ir, fallback, stats)
+
+	def stats(self, source, irw, cg):
+		# "lines <n>\nnodes <n>\nconstants <n>\n", then "<type> <nodes>
+		# <lines>\n" per node type, most lines first. iced.cpp checks these
+		# against its GLSL budgets
+		n = len(irw.objs)
+		names = list(irw.types)
+		node_counts = dict.fromkeys(names, 0)
+		for i in range(n): node_counts[names[irw.nodes[i*_IR_NODE_SIZE]]] += 1
+		for k in cg.line_counts: node_counts.setdefault(k, 0)
+		rows = sorted(node_counts, key=lambda k: (-cg.line_counts.get(k, 0), -node_counts[k], k))
+		out = ["lines %d" % (source.count("\n")+1), "nodes %d" % n, "constants %d" % cg.n_constants]
+		out += ["%s %d %d" % (k, node_counts[k], cg.line_counts.get(k, 0)) for k in rows]
+		return "\n".join(out) + "\n"
 
 def _register_view(dim, ctor):
 	name = ctor.__name__
@@ -332,9 +617,64 @@ class _WithWithoutParentheses:
 	def __call__(self):
 		return self.v()
 
+_f32 = struct.Struct("f")
+def _float_literal(x):
+	# shortest GLSL literal that reads back as the same float32 as x. with
+	# "%f" anything below 1e-6 vanished, and values that differ compiled the
+	# same (and the other way around), which confused anything keyed on the
+	# source. %g strips trailing zeros, so the first precision that
+	# round-trips is the shortest; 9 digits always do
+	assert math.isfinite(x), "%r has no GLSL literal" % x
+	f = _f32.unpack(_f32.pack(x))[0]
+	for prec in (6,7,8,9):
+		s = "%.*g" % (prec, f)
+		if _f32.unpack(_f32.pack(float(s)))[0] == f: break
+	if "." not in s and "e" not in s: s += ".0"
+	return s
+
+def _float_literals(xs):
+	# _float_literal() of each float32 in the array xs, batched: each
+	# precision is tried on everything still left, and array("f") does the
+	# round-trip check for all of them in one go
+	out = [None]*len(xs)
+	todo = range(len(xs))
+	for prec in (6,7,8,9):
+		fmt = "%%.%dg" % prec
+		cand = [fmt % xs[i] for i in todo]
+		back = array("f", map(float, cand))
+		left = []
+		for j,i in enumerate(todo):
+			if back[j] == xs[i] or prec == 9:
+				s = cand[j]
+				out[i] = s if ("." in s or "e" in s) else s + ".0"
+			else:
+				left.append(i)
+		todo = left
+	return out
+
 _isnum  = lambda v: isinstance(v,(float,int))
 _isvecn = lambda n,v: (len(v)==n) and (False not in [_isnum(x) for x in v])
 
+_INF = float("inf")
+_BINF = ((-_INF,-_INF,-_INF), (_INF,_INF,_INF))
+_BEMPTY = ((_INF,_INF,_INF), (-_INF,-_INF,-_INF))
+def _bunion(bs):
+	if not bs: return _BEMPTY
+	return (tuple(min(b[0][i] for b in bs) for i in range(3)), tuple(max(b[1][i] for b in bs) for i in range(3)))
+def _bintersect(bs):
+	if not bs: return _BEMPTY
+	return (tuple(max(b[0][i] for b in bs) for i in range(3)), tuple(min(b[1][i] for b in bs) for i in range(3)))
+def _bmove(b, d):
+	return (tuple(b[0][i]+d[i] for i in range(3)), tuple(b[1][i]+d[i] for i in range(3)))
+def _bscale(b, s):
+	lo = tuple(min(b[0][i]*s, b[1][i]*s) for i in range(3))
+	hi = tuple(max(b[0][i]*s, b[1][i]*s) for i in range(3))
+	return (lo, hi)
+def _bgrow(b, k):
+	return (tuple(x-k for x in b[0]), tuple(x+k for x in b[1]))
+def _bbox(x, y, z):
+	return ((-x,-y,-z), (x,y,z))
+
 class _Node:
 	argfmt = ""
 
@@ -344,6 +684,7 @@ class _Node:
 
 	@classmethod
 	def typd(t):
+		for r in _memo_recorders: r.types[t] = True
 		cg = _cg()
 		if not cg.once(t): return
 
@@ -396,17 +737,15 @@ class _Node:
 					self.mvar = mvar1
 				elif self.mvar != mvar1:
 					mvar2 = cg.ident("m")
-					cg.line("\tMaterial %s = %s < %s ? %s : %s;" % (mvar2, self.dvar, dvar1, self.mvar, mvar1))
+					cg.line("\tint %s = %s < %s ? %s : %s;" % (mvar2, self.dvar, dvar1, self.mvar, mvar1))
 					self.mvar = mvar2
 
 	def __init__(self):
 		pass
 
 	def exec(self, args):
-		type(self).typd()
-		cg = _cg()
-
-		#print(self.name(), args, "argfmt", self.argfmt)
+		# construction; validates the arguments and attaches the node to the
+		# tree. nothing is emitted until emit()
 		argfmt = self.argfmt
 		n = len(argfmt)
 		if n == 1:
@@ -414,39 +753,53 @@ class _Node:
 			if (c == "2" and len(args) == 2) or (c == "3" and len(args) == 3) or (c == "4" and len(args) == 4):
 				args = [args]
 		if len(args) != n: raise RuntimeError("invalid number of arguments; wanted %d; got %d" % (n, len(args)))
-		glsl_argstr = ""
 		for i in range(n):
 			c = argfmt[i]
 			a = args[i]
-			tt = None
-			lit = None
 			if c == "1":
 				assert _isnum(a), "argument %d not a number" % i
-				tt = "float"
-				lit = "%f" % a
 			elif c == "2":
 				assert _isvecn(2,a), "argument %d not a vec2" % i
-				tt = "vec2"
-				lit = "vec2(%f,%f)" % a
 			elif c == "3":
 				assert _isvecn(3,a), "argument %d not a vec3" % i
-				tt = "vec3"
-				lit = "vec3(%f,%f,%f)" % a
 			elif c == "4":
 				assert _isvecn(4,a), "argument %d not a vec4" % i
-				tt = "vec4"
-				lit = "vec4(%f,%f,%f,%f)" % a
 			else:
 				raise RuntimeError("unhandled argfmt char %s" % repr(c))
-			glsl_argstr += ", %s" % cg.constant(tt,lit)
-		self.glsl_argstr = glsl_argstr
 		self.args = args
 
-		top = cg.top()
-		self.pvar = top.pvar
-		self.dim = top.dim
+		cg = _cg()
+		cg.top().children.append(self)
+		if isinstance(self, _Scope):
+			self.children = []
+			cg.push(self)
 
-		if not _active_mset.empty() and hasattr(self, "mdef"): self.mdef(_active_mset)
+	def emit(self, parent):
+		type(self).typd()
+		cg = _cg()
+		owner = cg.owner
+		cg.owner = self.ir_name()
+
+		glsl_argstr = ""
+		k = getattr(self, "param0", 0) # set by _IRWriter
+		for c in self.argfmt:
+			n = int(c)
+			if cg.bulk:
+				# read in place; a constant per read would only add lines
+				glsl_argstr += ", P%d(%d)" % (n, k)
+			else:
+				lits = [cg.literal(j) for j in range(k, k+n)]
+				tt = "float" if n == 1 else "vec%d" % n
+				lit = lits[0] if n == 1 else "%s(%s)" % (tt, ",".join(lits))
+				glsl_argstr += ", %s" % cg.constant(tt,lit)
+			k += n
+		self.glsl_argstr = glsl_argstr
+
+		self.pvar = parent.pvar
+		self.dim = parent.dim
+		self.reset()
+
+		if cg.material and not _active_mset.empty() and hasattr(self, "mdef"): self.mdef(_active_mset)
 
 		if self.fn_tx:
 			pvar1 = cg.ident("p");
@@ -457,22 +810,49 @@ class _Node:
 			# TODO if layerselect()
 			dvar = cg.ident("d")
 			cg.line("\tfloat %s = %s(%s%s);" % (dvar, self.fn_map, self.pvar, glsl_argstr))
-			assert not hasattr(self, "dvar")
 			self.dvar = dvar
 
-		if self.is_leaf:
-			if hasattr(self, "dvar"):
-				top.rjoin(self)
-		else:
-			cg.push(self)
+		self.emit_children()
+
+		cg.owner = self.ir_name()
+		if self.fn_d11 and hasattr(self, "dvar"):
+			dvar1 = cg.ident("d")
+			cg.line("\tfloat %s = %s(%s%s);" % (dvar1, self.fn_d11, self.dvar, self.glsl_argstr))
+			self.dvar = dvar1
+		cg.owner = owner
+		if hasattr(self, "dvar"):
+			parent.rjoin(self)
+
+	def reset(self):
+		# forgets what the last emission left; a tree is emitted once per
+		# map_*() variant
+		self.__dict__.pop("dvar", None)
+		self.__dict__.pop("mvar", None)
+
+	def emit_children(self):
+		for c in getattr(self, "children", ()): c.emit(self)
+
+	# axis-aligned bounds as ((x0,y0,z0),(x1,y1,z1)) given those of the
+	# children; 2D nodes leave z at 0. scopes without a transform bound their
+	# children, leaves without an override are unbounded
+	def bound(self, kids):
+		return _bunion(kids)
 
 	def name(self):
 		return type(self).nname()
 
+	def ir_name(self):
+		# type name in the IR and in _View.stats()
+		return self.name()
+
 class _RootNode(_Node):
-	def __init__(self, pvar, dim):
-		self.pvar = pvar
+	def __init__(self, dim):
+		self.pvar = None # set on emission
 		self.dim = dim
+		self.children = []
+
+	def ir_name(self):
+		return "root"
 
 class _Scope(_Node):
 	def __init__(self, *args):
@@ -482,19 +862,15 @@ class _Scope(_Node):
 		self.exec(self.args)
 
 	def __exit__(self,type,value,tb):
-		cg = _cg()
-		cg.pop()
-		if self.fn_d11 and hasattr(self, "dvar"):
-			dvar1 = cg.ident("d")
-			cg.line("\tfloat %s = %s(%s%s);" % (dvar1, self.fn_d11, self.dvar, self.glsl_argstr))
-			self.dvar = dvar1
-		if hasattr(self, "dvar"):
-			cg.top().rjoin(self)
+		_cg().pop()
 
 class _Leaf(_Node):
 	def __init__(self, *args):
 		self.exec(args)
 
+	def bound(self, kids):
+		return _BINF
+
 class Material(_Scope):
 	albedo = None
 	emission = None
@@ -504,7 +880,275 @@ class Material(_Scope):
 		_wpp_todo.append(subcls) # magic via _WithWithoutParentheses
 
 	def mdef(self, mset):
-		self.mvar = _cg().constant("Material", mset.format(self))
+		self.mvar = str(_cg().material_id(type(self)))
+
+	def ir_name(self):
+		return "material"
+
+def _module_digest(name):
+	# content hash of a module's source file; None for modules without one
+	f = getattr(sys.modules.get(name), "__file__", None)
+	if f is None: return None
+	try:
+		st = os.stat(f)
+	except OSError:
+		return None
+	k = (f, st.st_mtime_ns, st.st_size)
+	if k not in _memo_digests:
+		with open(f, "rb") as fh: _memo_digests[k] = hashlib.sha1(fh.read()).hexdigest()
+	return _memo_digests[k]
+
+def _memo_valid(e):
+	for name,digest in e.deps.items():
+		if _module_digest(name) != digest: return False
+	return True
+
+def _memo_argkey(x):
+	if isinstance(x, _WithWithoutParentheses): x = x.v
+	if isinstance(x, type): return "%s.%s" % (x.__module__, x.__qualname__)
+	if isinstance(x, (tuple,list)): return "(%s)" % ",".join(_memo_argkey(y) for y in x)
+	if isinstance(x, dict): return "{%s}" % ",".join("%s:%s" % (_memo_argkey(k), _memo_argkey(v)) for k,v in sorted(x.items()))
+	return repr(x)
+
+def _memo_resolve(t):
+	# node classes are recorded as class objects, but a soft reload replaces
+	# them; use whatever currently goes by the same name
+	v = getattr(sys.modules.get(t.__module__), t.__qualname__, t)
+	if isinstance(v, _WithWithoutParentheses): v = v.v
+	return v if isinstance(v, type) else t
+
+class _MemoEntry:
+	def __init__(self, deps, dim, fn):
+		self.deps = deps # {module name: source digest}
+		self.root = _RootNode(dim) # what fn constructed
+		self.fn = fn # GLSL function name
+		self.types = {} # node types fn depends on, in definition order
+		self.needs = [] # keys of @subscene calls made by fn
+		self.emitted = False
+		self.src = None # None if fn constructed no geometry
+		self.src_d = None # the variant without materials, if it has any
+		self.materials = [] # see _Codegen.emit_subscene()
+		self.counts = []
+		self.ret = None
+
+def _memo_define(key):
+	# makes sure the GLSL function for key, and everything it calls, is
+	# defined; emits it on first use
+	e = _memo_cache[key]
+	cg = _cg()
+	if not e.emitted:
+		_memo_recorders.append(e)
+		try:
+			e.src, e.materials, counts = cg.emit_subscene(e.fn, e.root, True)
+			e.counts = [counts]
+			if e.materials:
+				e.src_d, _, counts = cg.emit_subscene(e.fn + "_d", e.root, False)
+				e.counts.append(counts)
+		finally:
+			_memo_recorders.remove(e)
+		e.emitted = True
+	else:
+		for k in e.needs: _memo_define(k)
+		for t in e.types: _memo_resolve(t).typd()
+	if e.src is not None and not cg.defined(e.fn):
+		cg.define(e.fn, e.src)
+		if e.src_d is not None: cg.define(e.fn + "_d", e.src_d)
+		for counts in e.counts: cg.count(counts)
+	return e
+
+class _SubsceneNode(_Node):
+	def __init__(self, key, root):
+		self.key = key
+		self.root = root
+
+	def emit(self, parent):
+		self.reset()
+		e = _memo_define(self.key)
+		if e.src is None: return
+		cg = _cg()
+		owner = cg.owner
+		cg.owner = "subscene"
+		self.dvar = cg.ident("d")
+		if e.materials and cg.material:
+			self.mvar = cg.ident("m")
+			cg.line("\tint %s;" % self.mvar)
+			cg.line("\tfloat %s = %s(%s, %s);" % (self.dvar, e.fn, parent.pvar, self.mvar))
+			# the sub-scene's IDs are its own; map them to ours
+			ids = [cg.material_id(t) for t in e.materials]
+			if len(ids) == 1:
+				self.mvar = str(ids[0])
+			elif ids != list(range(len(ids))):
+				mvar = cg.ident("m")
+				cg.line("\tint %s = int[](%s)[%s];" % (mvar, ", ".join(str(i) for i in ids), self.mvar))
+				self.mvar = mvar
+		elif e.materials:
+			cg.line("\tfloat %s = %s_d(%s);" % (self.dvar, e.fn, parent.pvar))
+		else:
+			cg.line("\tfloat %s = %s(%s);" % (self.dvar, e.fn, parent.pvar))
+		cg.owner = owner
+		parent.rjoin(self)
+
+	def ir_name(self):
+		return "subscene"
+
+def subscene(fn):
+	"""
+	marks a function that builds part of a scene as reusable. each distinct
+	set of arguments is generated once into a GLSL function, and every call
+	becomes a call to it. generated functions are keyed by the bytecode of fn
+	and its arguments, and kept across soft reloads until the source of fn's
+	module (or of a module of any @subscene it calls) or of iclib itself
+	changes. fn must only depend on its arguments and those modules.
+	"""
+	code_digest = hashlib.sha1(marshal.dumps(fn.__code__)).hexdigest()
+	ident = "%s.%s:%s" % (fn.__module__, fn.__qualname__, code_digest)
+	def wrapper(*args, **kwargs):
+		if _active_codegen is None: return fn(*args, **kwargs)
+		cg = _cg()
+		key = "%s%s%s/%d/%s" % (ident, _memo_argkey(args), _memo_argkey(kwargs), cg.dim, _memo_argkey(sorted(_active_mset.z)))
+		e = _memo_cache.get(key)
+		if e is not None and not _memo_valid(e):
+			del _memo_cache[key]
+			e = None
+		if e is not None:
+			_memo_stats[0] += 1
+		else:
+			_memo_stats[1] += 1
+			name = "%s_%s" % (fn.__name__, hashlib.sha1(key.encode()).hexdigest()[:12])
+			# iclib emits the GLSL, and _memo_cache outlives its re-runs
+			deps = {__name__: _module_digest(__name__), fn.__module__: _module_digest(fn.__module__)}
+			e = _MemoEntry(deps, cg.dim, name)
+			cg.push(e.root)
+			_memo_recorders.append(e)
+			try:
+				e.ret = fn(*args, **kwargs)
+			finally:
+				_memo_recorders.remove(e)
+				cg.pop()
+			_memo_cache[key] = e
+		for r in _memo_recorders:
+			r.deps.update(e.deps)
+			r.needs.append(key)
+		cg.top().children.append(_SubsceneNode(key, e.root))
+		return e.ret
+	wrapper.__name__ = fn.__name__
+	wrapper.__qualname__ = fn.__qualname__
+	wrapper.__doc__ = fn.__doc__
+	return wrapper
+
+_IR_MAGIC = 0x52494349 # "ICIR"
+_IR_VERSION = 1
+_IR_NODE_SIZE = 8
+
+class _IRWriter:
+	# serializes a constructed tree into the binary IR returned as
+	# _ViewGen.ir; icir.h has the reader. all fields are 32-bit, native
+	# byte order:
+	#
+	#   header     int[8]     magic, version, dim, n_nodes, n_params, n_materials, n_types, types_size
+	#   types      char[types_size]  NUL-terminated type names, padded to 4 bytes
+	#   nodes      int[n_nodes*8]    type, parent, first_child, next_sibling, param0, n_params, material, ref
+	#   bounds     float[n_nodes*6]  x0,y0,z0, x1,y1,z1
+	#   params     float[n_params]
+	#   materials  float[n_materials*6]  albedo, emission
+	#
+	# nodes are in preorder, starting with the view's root at 0. a "subscene"
+	# node calls the tree rooted at node `ref` (one root per distinct
+	# @subscene, after the view's tree), and "material" nodes index the
+	# material table. node types are otherwise named as in iclib. write()
+	# leaves each node's param0 on it for bulk emission (see bulk_params)
+	def __init__(self, dim):
+		self.dim = dim
+		self.types = {}
+		self.objs = []
+		self.nodes = array("i")
+		self.params = array("f")
+		self.materials = array("f")
+		self.material_index = {}
+		self.calls = []
+
+	def type(self, name):
+		i = self.types.get(name)
+		if i is None:
+			i = len(self.types)
+			self.types[name] = i
+		return i
+
+	def material(self, t):
+		i = self.material_index.get(t)
+		if i is None:
+			i = len(self.material_index)
+			self.material_index[t] = i
+			self.materials.extend(t.albedo or (0,0,0))
+			self.materials.extend(t.emission or (0,0,0))
+		return i
+
+	def add(self, node, parent):
+		i = len(self.objs)
+		self.objs.append(node)
+		material = -1
+		if isinstance(node, _SubsceneNode):
+			self.calls.append((i, node))
+		elif isinstance(node, Material):
+			# cached @subscene trees may hold types a soft reload replaced
+			material = self.material(_memo_resolve(type(node)))
+		param0 = len(self.params)
+		node.param0 = param0
+		for c,a in zip(node.argfmt, getattr(node, "args", ())):
+			if c == "1":
+				self.params.append(a)
+			else:
+				self.params.extend(a)
+		self.nodes.extend((self.type(node.ir_name()), parent, -1, -1, param0, len(self.params)-param0, material, -1))
+		prev = -1
+		for c in getattr(node, "children", ()):
+			ci = self.add(c, i)
+			if prev < 0:
+				self.nodes[i*_IR_NODE_SIZE + 2] = ci
+			else:
+				self.nodes[prev*_IR_NODE_SIZE + 3] = ci
+			prev = ci
+		return i
+
+	def write(self, root):
+		self.add(root, -1)
+		fnroots = {}
+		ci = 0
+		while ci < len(self.calls): # grows as called trees are added
+			(i, node) = self.calls[ci]
+			if node.key not in fnroots: fnroots[node.key] = self.add(node.root, -1)
+			self.nodes[i*_IR_NODE_SIZE + 7] = fnroots[node.key]
+			ci += 1
+
+		# children and called trees always come after a node, so bounds
+		# can be resolved back to front
+		n = len(self.objs)
+		bs = [None]*n
+		for i in reversed(range(n)):
+			rec = self.nodes[i*_IR_NODE_SIZE : (i+1)*_IR_NODE_SIZE]
+			if rec[7] >= 0:
+				kids = [bs[rec[7]]]
+			else:
+				kids = []
+				c = rec[2]
+				while c >= 0:
+					kids.append(bs[c])
+					c = self.nodes[c*_IR_NODE_SIZE + 3]
+			bs[i] = self.objs[i].bound(kids)
+		bounds = array("f")
+		for b in bs:
+			bounds.extend(b[0])
+			bounds.extend(b[1])
+
+		types = b"".join(name.encode() + b"\0" for name in self.types)
+		types += b"\0" * (-len(types) % 4)
+		header = array("i", (_IR_MAGIC, _IR_VERSION, self.dim, n, len(self.params), len(self.material_index), len(self.types), len(types)))
+		return b"".join((header.tobytes(), types, self.nodes.tobytes(), bounds.tobytes(), self.params.tobytes(), self.materials.tobytes()))
+
+def memoreport(): return "%d hits, %d misses, %d entries" % (_memo_stats[0], _memo_stats[1], len(_memo_cache))
+
+# drop what the edit that triggered this (re)load invalidated
+for _k in [k for k,e in _memo_cache.items() if not _memo_valid(e)]: del _memo_cache[_k]
 
 ##############################################################################
 
@@ -516,6 +1160,9 @@ class translate2(_Scope):
 		return p+r;
 	}
 	"""
+	def bound(self, kids):
+		(x,y) = self.args[0]
+		return _bmove(_bunion(kids), (-x,-y,0))
 
 class scale2(_Scope):
 	argfmt = "1"
@@ -531,6 +1178,8 @@ class scale2(_Scope):
 		return d*s;
 	}
 	"""
+	def bound(self, kids):
+		return _bscale(_bunion(kids), self.args[0])
 
 class circle2(_Leaf):
 	argfmt = "1"
@@ -540,6 +1189,9 @@ class circle2(_Leaf):
 		return length(p)-r;
 	}
 	"""
+	def bound(self, kids):
+		r = self.args[0]
+		return _bbox(r,r,0)
 
 class translate3(_Scope):
 	argfmt = "3"
@@ -549,6 +1201,9 @@ class translate3(_Scope):
 		return p+r;
 	}
 	"""
+	def bound(self, kids):
+		(x,y,z) = self.args[0]
+		return _bmove(_bunion(kids), (-x,-y,-z))
 
 class sphere3(_Leaf):
 	argfmt = "1"
@@ -558,6 +1213,9 @@ class sphere3(_Leaf):
 		return length(p)-r;
 	}
 	"""
+	def bound(self, kids):
+		r = self.args[0]
+		return _bbox(r,r,r)
 
 class box3(_Leaf):
 	argfmt = "3"
@@ -568,6 +1226,8 @@ class box3(_Leaf):
 		return length(max(q,0.0)) + min(max(q.x,max(q.y,q.z)),0.0);
 	}
 	"""
+	def bound(self, kids):
+		return _bbox(*self.args[0])
 
 class cylinder3(_Leaf):
 	argfmt = "1"
@@ -577,6 +1237,9 @@ class cylinder3(_Leaf):
 		return length(p.xz)-r;
 	}
 	"""
+	def bound(self, kids):
+		r = self.args[0]
+		return _bbox(r,_INF,r)
 
 class torus3(_Leaf):
 	argfmt = "11"
@@ -587,6 +1250,9 @@ class torus3(_Leaf):
 		return length(q)-r1;
 	}
 	"""
+	def bound(self, kids):
+		(r0,r1) = self.args
+		return _bbox(r0+r1,r1,r0+r1)
 
 class cappedtorus3(_Leaf):
 	argfmt = "211"
@@ -598,6 +1264,9 @@ class cappedtorus3(_Leaf):
 		return sqrt( dot(p,p) + ra*ra - 2.0*ra*k ) - rb;
 	}
 	"""
+	def bound(self, kids):
+		r = self.args[1] + self.args[2]
+		return _bbox(r,r,r)
 
 
 @_WithWithoutParentheses
@@ -618,6 +1287,8 @@ class subtract(_Scope):
 		return max(-d0, d1);
 	}
 	"""
+	def bound(self, kids):
+		return kids[0] if kids else _BEMPTY
 
 @_WithWithoutParentheses
 class intersect(_Scope):
@@ -627,6 +1298,8 @@ class intersect(_Scope):
 		return max(d0, d1);
 	}
 	"""
+	def bound(self, kids):
+		return _bintersect(kids)
 
 class smooth_union(_Scope):
 	argfmt = "1"
@@ -637,6 +1310,8 @@ class smooth_union(_Scope):
 		return mix(d1, d0, h) - k*h*(1.0-h);
 	}
 	"""
+	def bound(self, kids):
+		return _bgrow(_bunion(kids), self.args[0])
 
 class smooth_subtract(_Scope):
 	argfmt = "1"
@@ -647,6 +1322,8 @@ class smooth_subtract(_Scope):
 		return mix(d1, -d0, h) + k*h*(1.0-h);
 	}
 	"""
+	def bound(self, kids):
+		return kids[0] if kids else _BEMPTY
 
 
 class smooth_intersect(_Scope):
@@ -658,3 +1335,5 @@ class smooth_intersect(_Scope):
 		return mix(d1, d0, h) + k*h*(1.0-h);
 	}
 	"""
+	def bound(self, kids):
+		return _bintersect(kids)
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+# codegen worker; iced.cpp runs a pool of these so that view constructors run
+# in parallel and a runaway world script can be killed without taking the
+# editor down. requests arrive on stdin, one per line:
+#
+#   import          import the world (or reload it and iclib, like a soft reload)
+#   view <name>     call view <name> and return its GLSL source, fallback
+#                   source, stats and IR, separated by NUL bytes (importing the
+#                   world first if needed, e.g. in a respawned worker)
+#
+# every request gets exactly one reply on stdout: a "<status> <size>\n" header
+# where status is "ok" or "error", followed by <size> bytes of payload (the
+# source, or a traceback). anything the world prints goes to stderr.
+#
+#   ./icworker.py <world module>
+
+import sys, traceback
+
+def main():
+	world_name = sys.argv[1]
+	out = sys.stdout.buffer
+	sys.stdout = sys.stderr
+	sys.path.insert(0, "")
+	world = None
+
+	def reply(status, payload):
+		out.write(b"%s %d\n" % (status, len(payload)))
+		out.write(payload)
+		out.flush()
+
+	for line in sys.stdin.buffer:
+		req = line.decode().split()
+		if not req: continue
+		try:
+			if req[0] == "import":
+				if world is None:
+					world = __import__(world_name)
+				else:
+					import importlib, iclib
+					importlib.reload(iclib)
+					world = importlib.reload(world)
+				reply(b"ok", b"")
+			elif req[0] == "view":
+				if world is None: world = __import__(world_name)
+				r = getattr(world, req[1])()
+				reply(b"ok", b"\0".join((r.source.encode(), r.fallback.encode(), r.stats.encode(), r.ir)))
+			else:
+				reply(b"error", ("bad request %r\n" % req[0]).encode())
+		except Exception:
+			reply(b"error", traceback.format_exc().encode())
+
+if __name__ == "__main__":
+	main()
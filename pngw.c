@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pngw.h"
+
+static uint32_t crc_table[256];
+
+static void crc_init(void)
+{
+	if (crc_table[1] != 0) return;
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+		crc_table[n] = c;
+	}
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t* p, size_t n)
+{
+	for (size_t i = 0; i < n; i++) crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static void put_u32be(uint8_t* p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void write_bytes(struct pngw* png, const void* p, size_t n)
+{
+	if (png->error) return;
+	if (fwrite(p, n, 1, png->file) != 1) png->error = 1;
+}
+
+// writes a chunk whose data is given as up to two parts (header + payload)
+static void write_chunk(struct pngw* png, const char* type, const uint8_t* d0, size_t n0, const uint8_t* d1, size_t n1)
+{
+	uint8_t hdr[8];
+	put_u32be(hdr, (uint32_t)(n0 + n1));
+	memcpy(hdr+4, type, 4);
+	write_bytes(png, hdr, 8);
+	uint32_t crc = crc_update(0xffffffffu, hdr+4, 4);
+	if (n0 > 0) {
+		write_bytes(png, d0, n0);
+		crc = crc_update(crc, d0, n0);
+	}
+	if (n1 > 0) {
+		write_bytes(png, d1, n1);
+		crc = crc_update(crc, d1, n1);
+	}
+	uint8_t tail[4];
+	put_u32be(tail, crc ^ 0xffffffffu);
+	write_bytes(png, tail, 4);
+}
+
+static void adler_update(struct pngw* png, const uint8_t* p, size_t n)
+{
+	uint32_t a = png->adler_a, b = png->adler_b;
+	for (size_t i = 0; i < n; i++) {
+		a = (a + p[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	png->adler_a = a;
+	png->adler_b = b;
+}
+
+int pngw_open(struct pngw* png, const char* path, int width, int height)
+{
+	crc_init();
+	memset(png, 0, sizeof *png);
+	png->file = fopen(path, "wb");
+	if (png->file == NULL) return -1;
+	png->width = width;
+	png->height = height;
+	png->adler_a = 1;
+
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	write_bytes(png, signature, sizeof signature);
+
+	uint8_t ihdr[13];
+	put_u32be(ihdr, width);
+	put_u32be(ihdr+4, height);
+	ihdr[8] = 8;  // bit depth
+	ihdr[9] = 2;  // colour type: RGB
+	ihdr[10] = 0; // compression
+	ihdr[11] = 0; // filter
+	ihdr[12] = 0; // interlace
+	write_chunk(png, "IHDR", ihdr, sizeof ihdr, NULL, 0);
+
+	// zlib header: deflate, 32k window, no preset dictionary, fastest
+	static const uint8_t zhdr[] = { 0x78, 0x01 };
+	write_chunk(png, "IDAT", zhdr, sizeof zhdr, NULL, 0);
+
+	return png->error ? -1 : 0;
+}
+
+int pngw_write_rows(struct pngw* png, const uint8_t* rows, int n_rows, size_t stride)
+{
+	const size_t row_size = (size_t)png->width * 3;
+	uint8_t* buf = (uint8_t*)malloc(row_size + 1);
+	if (buf == NULL) return -1;
+	for (int y = 0; y < n_rows && png->rows_written < png->height; y++) {
+		buf[0] = 0; // filter: none
+		memcpy(buf+1, rows + y*stride, row_size);
+		adler_update(png, buf, row_size+1);
+		const int is_last_row = (png->rows_written == png->height-1);
+
+		// one IDAT per row holding as many stored blocks as needed
+		size_t off = 0;
+		const size_t n = row_size+1;
+		while (off < n) {
+			size_t bn = n - off;
+			if (bn > 65535) bn = 65535;
+			const int is_final = is_last_row && (off+bn == n);
+			uint8_t bhdr[5];
+			bhdr[0] = is_final ? 1 : 0;
+			bhdr[1] = bn & 0xff;
+			bhdr[2] = (bn >> 8) & 0xff;
+			bhdr[3] = ~bn & 0xff;
+			bhdr[4] = (~bn >> 8) & 0xff;
+			write_chunk(png, "IDAT", bhdr, sizeof bhdr, buf+off, bn);
+			off += bn;
+		}
+		png->rows_written++;
+	}
+	free(buf);
+	return png->error ? -1 : 0;
+}
+
+int pngw_close(struct pngw* png)
+{
+	if (png->rows_written == png->height) {
+		uint8_t adler[4];
+		put_u32be(adler, (png->adler_b << 16) | png->adler_a);
+		write_chunk(png, "IDAT", adler, sizeof adler, NULL, 0);
+		write_chunk(png, "IEND", NULL, 0, NULL, 0);
+	} else {
+		png->error = 1;
+	}
+	if (fclose(png->file) != 0) png->error = 1;
+	png->file = NULL;
+	return png->error ? -1 : 0;
+}
@@ -0,0 +1,34 @@
+#ifndef PNGW_H
+
+// minimal streaming PNG writer (8-bit RGB). rows are written top to bottom
+// as they become available, so the full image never has to be in memory.
+// pixel data is stored uncompressed (deflate "stored" blocks).
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pngw {
+	FILE* file;
+	int width, height;
+	int rows_written;
+	uint32_t adler_a, adler_b;
+	int error;
+};
+
+// returns 0 on success
+int pngw_open(struct pngw* png, const char* path, int width, int height);
+// writes n_rows rows of width*3 bytes each, stride bytes apart
+int pngw_write_rows(struct pngw* png, const uint8_t* rows, int n_rows, size_t stride);
+// returns 0 if the whole image was written without errors
+int pngw_close(struct pngw* png);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PNGW_H
+#endif